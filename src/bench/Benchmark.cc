@@ -0,0 +1,289 @@
+// File         : Benchmark.cc
+// Description  : Times each stage of the generator over a range of
+//                program sizes (the crazybench executable).
+
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <stdlib.h>
+#include <stdint.h>
+#include "ClassTree.h"
+#include "CodeGenerator.h"
+#include "ClassGenerator.h"
+#include "NameGenerator.h"
+#include "NameRegistry.h"
+#include "OutputWriter.h"
+#include "Random.h"
+#include "util.h"
+
+using namespace std;
+
+// STRUCT BenchResult
+// ------------------
+// The measurements for one program size. Sent from the child
+// process that ran them as raw bytes, so it holds no pointers.
+struct BenchResult {
+  int classes;
+  long long names;
+  double name_seconds;
+  double tree_seconds;
+  long long expressions;
+  double expression_seconds;
+  long long output_bytes;
+  double output_seconds;
+  long peak_rss_kb;
+};
+
+// Settings shared by every run.
+struct BenchSettings {
+  uint64_t seed;
+  string corpus_name;
+  string output_path;
+};
+
+// FUNCTION: Returns the seconds since @start.
+static double seconds_since(chrono::steady_clock::time_point start) {
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// FUNCTION: Returns @count / @seconds, or 0 if no time was measured.
+static double rate(double count, double seconds) {
+  return seconds > 0 ? count / seconds : 0;
+}
+
+// FUNCTION: Runs every stage for a program of @num_classes classes.
+// NOTES: - Names: @num_classes class names through a NameAllocator, and three
+//          attribute names per class through generate, as ClassTree does.
+//        - Tree: the class tree of the CodeGenerator the other stages use,
+//          as timed by it (without the tables derived from it).
+//        - Expressions: every class body, generated by one ClassGenerator
+//          with the random streams generate_code gives them.
+//        - Output: writing those bodies to the output file, timed apart
+//          from generating them.
+static BenchResult run_stages(int num_classes, const BenchSettings& settings) {
+  BenchResult result;
+  memset(&result, 0, sizeof(result));
+  result.classes = num_classes;
+
+  // Name generation.
+  NameGenerator name_generator(settings.corpus_name, 10, 5, 5, 5, 10);
+  Random name_rng = Random(settings.seed);
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  NameRegistry class_names = NameRegistry();
+  NameAllocator allocator = NameAllocator(name_generator, NameType::className, name_rng);
+  for (int i = 0; i < num_classes; i++) {
+    allocator.next(class_names);
+  }
+  NameRegistry attribute_names = NameRegistry();
+  for (int i = 0; i < num_classes; i++) {
+    attribute_names.clear();
+    for (int j = 0; j < 3; j++) {
+      name_generator.generate(NameType::attribute, attribute_names, name_rng);
+    }
+  }
+  result.name_seconds = seconds_since(start);
+  result.names = 4LL * num_classes;
+
+  // Class tree, as built (and timed) by the CodeGenerator itself.
+  CodeGenerator code_generator(num_classes, settings.corpus_name, 1, settings.seed, "/dev/null");
+  result.tree_seconds = code_generator.class_tree_seconds();
+
+  // Expressions and output.
+  const ClassTree& generated_tree = code_generator.class_tree();
+  ClassGenerator generator(code_generator);
+  OutputWriter writer(settings.output_path);
+  Random random = Random(settings.seed);
+  for (int i = 0; i < generated_tree.class_names.size(); i++) {
+    string class_name = generated_tree.class_names[i];
+    if (class_name == "Object" || class_name == "Bool" ||
+        class_name == "String" || class_name == "Int" ||
+        class_name == "IO") continue;
+
+    start = chrono::steady_clock::now();
+    generator.generate_class(class_name, random.derive(i + 1));
+    result.expression_seconds += seconds_since(start);
+    result.expressions += generator.expressions();
+
+    start = chrono::steady_clock::now();
+    writer.append(generator.output().data(), generator.output().size());
+    result.output_seconds += seconds_since(start);
+  }
+  start = chrono::steady_clock::now();
+  writer.close();
+  result.output_seconds += seconds_since(start);
+  result.output_bytes = writer.bytes_written();
+  unlink(settings.output_path.c_str());
+
+  return result;
+}
+
+// FUNCTION: Runs run_stages in a child process, so that the peak
+// resident set size is that of this size alone.
+static BenchResult run_isolated(int num_classes, const BenchSettings& settings) {
+  int fds[2];
+  if (pipe(fds) != 0) throw string("Benchmark: pipe failed: ") + strerror(errno);
+
+  pid_t pid = fork();
+  if (pid < 0) throw string("Benchmark: fork failed: ") + strerror(errno);
+  if (pid == 0) {
+    close(fds[0]);
+    int status = 0;
+    try {
+      BenchResult result = run_stages(num_classes, settings);
+      if (write(fds[1], &result, sizeof(result)) != sizeof(result)) status = 1;
+    } catch (string e) {
+      cerr << "Error: " << e << endl;
+      status = 1;
+    } catch (const char* e) {
+      cerr << "Error: " << e << endl;
+      status = 1;
+    }
+    _exit(status);
+  }
+
+  close(fds[1]);
+  BenchResult result;
+  size_t received = 0;
+  while (received < sizeof(result)) {
+    ssize_t count = read(fds[0], (char*) &result + received, sizeof(result) - received);
+    if (count <= 0) break;
+    received += count;
+  }
+  close(fds[0]);
+
+  int status;
+  struct rusage usage;
+  if (wait4(pid, &status, 0, &usage) < 0) throw string("Benchmark: wait4 failed: ") + strerror(errno);
+  if (received != sizeof(result) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+    throw "Benchmark: run with " + to_string(num_classes) + " classes failed.";
+  }
+  result.peak_rss_kb = usage.ru_maxrss;
+  return result;
+}
+
+// FUNCTION: Prints one result as a row of the summary table.
+static void print_row(const BenchResult& r) {
+  cout << setw(8) << r.classes
+       << setw(12) << (long long) rate(r.names, r.name_seconds)
+       << setw(12) << (long long) rate(r.classes, r.tree_seconds)
+       << setw(12) << (long long) rate(r.classes, r.expression_seconds)
+       << setw(14) << (long long) rate(r.expressions, r.expression_seconds)
+       << setw(10) << rate(r.output_bytes / 1e6, r.output_seconds)
+       << setw(12) << r.peak_rss_kb << endl;
+}
+
+// FUNCTION: Writes the results to @prefix.csv and @prefix.json.
+static void write_results(const vector<BenchResult>& results, const BenchSettings& settings,
+                          const string& prefix) {
+  ofstream csv((prefix + ".csv").c_str());
+  ofstream json((prefix + ".json").c_str());
+  if (!csv || !json) throw "Benchmark: can't write results to " + prefix + ".{csv,json}.";
+
+  csv << "classes,seed,name_seconds,names_per_second,tree_seconds,tree_classes_per_second,"
+      << "expression_seconds,expressions,classes_per_second,expressions_per_second,"
+      << "output_seconds,output_megabytes,output_megabytes_per_second,peak_rss_kb" << endl;
+  json << "{\"seed\": " << settings.seed << ", \"results\": [";
+  for (int i = 0; i < results.size(); i++) {
+    const BenchResult& r = results[i];
+    double megabytes = r.output_bytes / 1e6;
+    csv << r.classes << ',' << settings.seed << ','
+        << r.name_seconds << ',' << rate(r.names, r.name_seconds) << ','
+        << r.tree_seconds << ',' << rate(r.classes, r.tree_seconds) << ','
+        << r.expression_seconds << ',' << r.expressions << ','
+        << rate(r.classes, r.expression_seconds) << ',' << rate(r.expressions, r.expression_seconds) << ','
+        << r.output_seconds << ',' << megabytes << ',' << rate(megabytes, r.output_seconds) << ','
+        << r.peak_rss_kb << endl;
+    json << (i == 0 ? "" : ",") << "\n  {\"classes\": " << r.classes
+         << ", \"names\": {\"seconds\": " << r.name_seconds
+         << ", \"per_second\": " << rate(r.names, r.name_seconds) << "}"
+         << ", \"tree\": {\"seconds\": " << r.tree_seconds
+         << ", \"classes_per_second\": " << rate(r.classes, r.tree_seconds) << "}"
+         << ", \"expressions\": {\"seconds\": " << r.expression_seconds
+         << ", \"count\": " << r.expressions
+         << ", \"classes_per_second\": " << rate(r.classes, r.expression_seconds)
+         << ", \"per_second\": " << rate(r.expressions, r.expression_seconds) << "}"
+         << ", \"output\": {\"seconds\": " << r.output_seconds
+         << ", \"megabytes\": " << megabytes
+         << ", \"megabytes_per_second\": " << rate(megabytes, r.output_seconds) << "}"
+         << ", \"peak_rss_kb\": " << r.peak_rss_kb << "}";
+  }
+  json << "\n]}" << endl;
+}
+
+// FUNCTION: main execution
+// NOTES: Flags:
+//          -n N      largest program size (default 100000); sizes are the
+//                    powers of ten from 10 up to N, then N itself
+//          -s SEED   seed of every run (default 1)
+//          -w PATH   corpus to draw names from
+//          -o PATH   scratch file for the output stage (default bench_output.cl)
+//          -r PREFIX results go to PREFIX.csv and PREFIX.json (default bench_results)
+int main(int argc, char* argv[]) {
+  int max_classes = 100000;
+  string results_prefix = "bench_results";
+  BenchSettings settings;
+  settings.seed = 1;
+  settings.output_path = "bench_output.cl";
+
+  int c;
+  while ((c = getopt (argc, argv, "n:s:w:o:r:")) != -1) {
+    switch(c) {
+      case 'n':
+        if (!parse_int("-n", optarg, max_classes)) return 1;
+        break;
+      case 's':
+        if (!parse_seed(optarg, settings.seed)) return 1;
+        break;
+      case 'w':
+        settings.corpus_name = optarg;
+        break;
+      case 'o':
+        settings.output_path = optarg;
+        break;
+      case 'r':
+        results_prefix = optarg;
+        break;
+      default:
+        return 1;  // getopt has printed what is wrong.
+    }
+  }
+
+  vector<int> sizes = vector<int>();
+  for (long long n = 10; n < max_classes; n *= 10) {
+    sizes.push_back(n);
+  }
+  sizes.push_back(max_classes);
+
+  try {
+    cout << "Seed: " << settings.seed << endl;
+    cout << setw(8) << "classes" << setw(12) << "names/s" << setw(12) << "tree cl/s"
+         << setw(12) << "expr cl/s" << setw(14) << "expr/s" << setw(10) << "out MB/s"
+         << setw(12) << "peak KB" << endl;
+    vector<BenchResult> results = vector<BenchResult>();
+    for (int i = 0; i < sizes.size(); i++) {
+      results.push_back(run_isolated(sizes[i], settings));
+      print_row(results.back());
+      write_results(results, settings, results_prefix);
+    }
+    cout << "Results written to " << results_prefix << ".csv and " << results_prefix << ".json." << endl;
+
+  } catch (string e) {
+    cerr << "Error: " << e << endl;
+    return 1;
+  } catch (const char* e) {
+    cerr << "Error: " << e << endl;
+    return 1;
+  }
+
+  return 0;
+}
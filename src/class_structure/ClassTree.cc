@@ -1,15 +1,20 @@
 // File         : ClassTree.cc
 // Description  : Implemention of ClassTree class for generating class structure.
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <iostream>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include <stdlib.h>
 #include "ClassTree.h"
 #include "util.h"
 #include "NameGenerator.h"
+#include "NameRegistry.h"
+#include "Random.h"
+#include "Trace.h"
 
 using namespace std;
 
@@ -19,8 +24,10 @@ ClassTree::ClassTree(   const NameGenerator& name_generator,
                         int num_attributes_per_class,
                         int num_methods_per_class,
                         int max_num_method_args,
-                        float probability_repeat_method_name):
-                        name_generator(name_generator) {
+                        float probability_repeat_method_name,
+                        const Random& rng):
+                        name_generator(name_generator),
+                        rng(rng) {
 
   // Set internal variables.
   this->probability_repeat_method_name = probability_repeat_method_name;
@@ -64,17 +71,14 @@ void ClassTree::print_class_information() {
       cout << "\tClass: " << current_class << endl;
 
       cout << "\t\t[ ";
-      for (int j = 0; j < class_ancestors[current_class].size(); j++) {
-        string current_ancestor = class_ancestors[current_class][j];
-        cout << current_ancestor << " ";
+      for (int j = class_parent[i]; j != -1; j = class_parent[j]) {
+        cout << class_names[j] << " ";
       }
       cout << "]" << endl;
 
       cout << "\t\t{ ";
-      for (set<string>::iterator it = class_descendants[current_class].begin();
-                      it != class_descendants[current_class].end(); ++it) {
-        string current_descendant = *it;
-        cout << current_descendant << " ";
+      for (int j = 1; j < class_subtree_size[i]; j++) {
+        cout << class_names[subtype(i, j)] << " ";
       }
       cout << "}" << endl;
   }
@@ -114,136 +118,140 @@ void ClassTree::print_class_information() {
 // FUNCTION: Populates class_names with random strings + Main (no basic classes).
 void ClassTree::generate_class_names() {
   class_names = vector<string>();
+  NameRegistry reserved_names = NameRegistry();
+  NameAllocator allocator = NameAllocator(name_generator, NameType::className, rng);
 
-  // Generate class names.
+  // Generate class names. These never run out.
   for (int i = 0; i < num_classes; i++) {
-    try {
-      string class_name = name_generator.generate(NameType::className, class_names);
-      class_names.push_back(class_name);
-    } catch (string e) {
-      cout << "Error: " << e << endl;
-    }
+    class_names.push_back(allocator.next(reserved_names));
   }
 
   // Add Main class.
   class_names.push_back("Main");
 }
 
-// FUNCTION: Updates ancestor vectors for child-parent connection.
-void ClassTree::update_ancestor_vectors(string child, string parent) {
-
-  // Append parent lineage to child ancestor vector.
-  vector<string> parent_ancestors = class_ancestors[parent];
-  vector<string>& child_ancestors = class_ancestors[child];
-  child_ancestors.push_back(parent);
-  child_ancestors.insert(child_ancestors.end(), parent_ancestors.begin(), parent_ancestors.end());
-
-  // Update the ancestors of each children of child.
-  set<string> child_descendants = class_descendants[child];
-  for (set<string>::iterator it = child_descendants.begin(); it != child_descendants.end(); ++it) {
-    string current_class = *it;
-    vector<string>& current_ancestors = class_ancestors[current_class];
-    current_ancestors.insert(current_ancestors.end(), child_ancestors.begin(), child_ancestors.end());
-  }
-}
-
-// FUNCTION: Updates child sets for child-parent connection.
-// NOTE: Assumes ancestor vectors have been updated.
-void ClassTree::update_child_sets(string child, string parent) {
-
-  set<string> child_descendants = class_descendants[child];
-  child_descendants.insert(child);
-  vector<string> child_ancestors = class_ancestors[child];
-  for (int i = 0; i < child_ancestors.size(); i++) {
-    string current_ancestor = child_ancestors[i];
-    set<string>& current_descendants = class_descendants[current_ancestor];
-    current_descendants.insert(child_descendants.begin(), child_descendants.end());
-  }
+// FUNCTION: Adds the basic classes to class_names.
+void ClassTree::add_basic_classes() {
+  class_names.push_back("Object");
+  class_names.push_back("IO");
+  class_names.push_back("Int");
+  class_names.push_back("String");
+  class_names.push_back("Bool");
 }
 
 // FUNCTION: Generates inheritance for all classes in class_names.
-// NOTE:  This assumes that class_names does NOT contain basic classes.
-// NOTE:  This will add Object, IO to class_descendants and class_ancestors,
-//        but not other basic classes.
+// NOTE:  This assumes that class_names ends with the basic classes,
+//        which all inherit from Object.
+// NOTE:  The other classes are placed in a random order, each under a
+//        random class placed before it (Object and IO to start with).
+//        That can never make a cycle, so nothing has to be checked
+//        and the whole tree takes O(N).
 void ClassTree::generate_inheritance() {
-
-  // Initialize map data structures.
-  class_ancestors = map<string, vector<string> >();
-  class_descendants = map<string, set<string> >();
-
-  for (int i = 0; i < class_names.size(); i++) {
-    class_ancestors[class_names[i]] = vector<string>();
-    class_descendants[class_names[i]] = set<string>();
+  int num_total_classes = class_names.size();
+  class_ids = unordered_map<string, int>();
+  for (int i = 0; i < num_total_classes; i++) {
+    class_ids[class_names[i]] = i;
   }
 
-  // Add Object and IO manually to ancestor and descendant maps.
-  class_descendants["Object"] = set<string>();
-  class_descendants["Object"].insert("IO");
-  class_descendants["IO"] = set<string>();
-  class_ancestors["Object"] = vector<string>();
-  class_ancestors["IO"] = vector<string>();
-  class_ancestors["IO"].push_back("Object");
-
-  // Create a vector of possible parents.
-  vector<string> possible_parents = vector<string>(class_names);
-  possible_parents.push_back("IO");
-  possible_parents.push_back("Object");
+  // Basic classes. Only Object and IO may be inherited from.
+  int num_basic_classes = 5;
+  int object_id = class_ids["Object"];
+  class_parent = vector<int>(num_total_classes, -1);
+  for (int i = num_total_classes - num_basic_classes; i < num_total_classes; i++) {
+    if (i != object_id) class_parent[i] = object_id;
+  }
+  vector<int> placed = vector<int>();
+  placed.reserve(num_total_classes);
+  placed.push_back(object_id);
+  placed.push_back(class_ids["IO"]);
+
+  // Every other class, in a random order.
+  vector<int> order = vector<int>();
+  for (int i = 0; i < num_total_classes - num_basic_classes; i++) {
+    order.push_back(i);
+  }
+  shuffle(order.begin(), order.end(), rng);
+  for (int i = 0; i < order.size(); i++) {
+    class_parent[order[i]] = placed[rng.below(placed.size())];
+    placed.push_back(order[i]);
+  }
+}
 
-  for(int i = 0; i < class_names.size(); i++) {
-    string current_class = class_names[i];
-    string parent_class = "";
+// FUNCTION: Assigns pre/post-order numbers and depths to every class.
+// NOTE:  Assumes the class tree is complete (basic classes included).
+//        A class C <= P exactly when P is entered before C and left after C.
+void ClassTree::number_classes() {
+  int num_total_classes = class_names.size();
+
+  // Build child lists from the parent of each class.
+  int root = class_ids["Object"];
+  vector<vector<int> > children = vector<vector<int> >(num_total_classes);
+  for (int i = 0; i < num_total_classes; i++) {
+    if (i == root) continue;
+    children[class_parent[i]].push_back(i);
+  }
 
-    // Compute possible parents for current class.
-    set<string> current_descendants = class_descendants[current_class];
-    set<string> current_possible_parents = set<string>(possible_parents.begin(), possible_parents.end());
-    for (set<string>::iterator it = current_descendants.begin(); it != current_descendants.end(); ++it) {
-      current_possible_parents.erase(*it);
+  // Walk the tree with an explicit stack, since chains can be deep.
+  // Stack entries are (class id, index of the next child to visit).
+  class_preorder = vector<int>(num_total_classes);
+  class_postorder = vector<int>(num_total_classes);
+  class_depth = vector<int>(num_total_classes);
+  class_subtree_size = vector<int>(num_total_classes);
+  preorder_classes = vector<int>(num_total_classes);
+  int preorder_count = 0;
+  int postorder_count = 0;
+  vector<pair<int, int> > stack = vector<pair<int, int> >();
+  preorder_classes[preorder_count] = root;
+  class_preorder[root] = preorder_count++;
+  class_depth[root] = 0;
+  stack.push_back(pair<int, int>(root, 0));
+  while (!stack.empty()) {
+    int current_class = stack.back().first;
+    int next_child = stack.back().second;
+    if (next_child < children[current_class].size()) {
+      stack.back().second++;
+      int child = children[current_class][next_child];
+      preorder_classes[preorder_count] = child;
+      class_preorder[child] = preorder_count++;
+      class_depth[child] = class_depth[current_class] + 1;
+      stack.push_back(pair<int, int>(child, 0));
+    } else {
+      class_postorder[current_class] = postorder_count++;
+      class_subtree_size[current_class] = preorder_count - class_preorder[current_class];
+      stack.pop_back();
     }
-    current_possible_parents.erase(current_class);
-
-    // Choose parent randomly.
-    set<string>::iterator it = current_possible_parents.begin();
-    advance(it, rand() % current_possible_parents.size());
-    parent_class = *it;
-
-    // Update data structures.
-    update_ancestor_vectors(current_class, parent_class);
-    update_child_sets(current_class, parent_class);
-
   }
-}
 
-// FUNCTION: Adds basic classes to data structures.
-// NOTE:  Assumes that Object, IO have been added to class_descendants and
-//        class_ancestors but no other basic classes have been added to any
-//        data structures.
-void ClassTree::add_basic_classes() {
-  class_names.push_back("Object");
-  class_names.push_back("IO");
-  class_names.push_back("Int");
-  class_names.push_back("String");
-  class_names.push_back("Bool");
-  class_descendants["Int"] = set<string>();
-  class_descendants["String"] = set<string>();
-  class_descendants["Bool"] = set<string>();
-  class_ancestors["Int"] = vector<string>();
-  class_ancestors["Int"].push_back("Object");
-  class_ancestors["String"] = vector<string>();
-  class_ancestors["String"].push_back("Object");
-  class_ancestors["Bool"] = vector<string>();
-  class_ancestors["Bool"].push_back("Object");
+  // Prefix sums used to count and index nested pairs.
+  preorder_depth_sums = vector<long long>(num_total_classes + 1, 0);
+  for (int i = 0; i < num_total_classes; i++) {
+    preorder_depth_sums[i + 1] = preorder_depth_sums[i] + class_depth[preorder_classes[i]] + 1;
+  }
 }
 
 // FUNCTION: Generates class tree.
-void ClassTree::generate_class_tree() {
+void ClassTree::generate_class_tree(TraceBuffer* trace) {
 
-  generate_class_names();
-  generate_inheritance();
-  add_basic_classes();
+  run_phase(trace, "class_names", &ClassTree::generate_class_names);
+  run_phase(trace, "basic_classes", &ClassTree::add_basic_classes);
+  run_phase(trace, "inheritance", &ClassTree::generate_inheritance);
+  run_phase(trace, "numbering", &ClassTree::number_classes);
+}
+
+// FUNCTION: Runs @phase, recording it in @trace (if any) as a span called @name.
+void ClassTree::run_phase(TraceBuffer* trace, const char* name, void (ClassTree::*phase)()) {
+  if (trace) trace->begin("class_tree", name);
+  (this->*phase)();
+  if (trace) trace->end();
 }
 
 // FUNCTION: Generates class attributes.
 // NOTE: String, Int, and Bool classes are given no attributes.
+// NOTE: Classes are visited in preorder, so every class comes after its
+//       ancestors and before its descendants. The names a class cannot use
+//       are then exactly its ancestors' attribute names, which are kept in
+//       one registry along the path from Object: each class adds its own
+//       names and takes them back out once its subtree is done.
 void ClassTree::generate_class_attributes() {
 
   // Initialize data structures.
@@ -253,41 +261,27 @@ void ClassTree::generate_class_attributes() {
   vector<string> possible_attribute_types = class_names;
   possible_attribute_types.push_back("SELF_TYPE");
 
+  // Attribute names of the classes on the path from Object.
+  NameRegistry reserved_names = NameRegistry();
+  vector<int> path = vector<int>();
+
   // Generate attributes for each class.
-  for (int i = 0; i < class_names.size(); i++) {
+  for (int p = 0; p < preorder_classes.size(); p++) {
 
     // Extract class and initialize data structures.
+    int i = preorder_classes[p];
     string current_class = class_names[i];
+    class_attributes[current_class] = vector<pair<string, string> >();
 
-    // Attributes cannot be duplicated within a class and
-    // we can't use the names of inherited attributes.
-    // Because we aren't traversing the tree in a particular order
-    // this means that we need to check the descendants as well.
-    vector<string> disallowed_attribute_names = vector<string>();
-
-    // Add ancestor attribute names.
-    vector<string> ancestors = class_ancestors[current_class];
-    for (int j = 0; j < ancestors.size(); j++) {
-      string ancestor = ancestors[j];
-      vector<pair<string, string> > ancestor_attributes = class_attributes[ancestor];
-      for (int k = 0; k < ancestor_attributes.size(); k++) {
-        string attribute_name = ancestor_attributes[k].first;
-        disallowed_attribute_names.push_back(attribute_name);
-      }
-    }
-
-    // Add descendant attribute names.
-    set<string> descendants = class_descendants[current_class];
-    for (set<string>::iterator it = descendants.begin(); it != descendants.end(); ++it) {
-      string descendant = *it;
-      vector<pair<string, string> > descendant_attributes = class_attributes[descendant];
-      for (int k = 0; k < descendant_attributes.size(); k++) {
-        string attribute_name = descendant_attributes[k].first;
-        disallowed_attribute_names.push_back(attribute_name);
+    // Leave the subtrees that are done.
+    while (!path.empty() && path.back() != class_parent[i]) {
+      const vector<pair<string, string> >& done_attributes = class_attributes[class_names[path.back()]];
+      for (int j = 0; j < done_attributes.size(); j++) {
+        reserved_names.erase(done_attributes[j].first);
       }
+      path.pop_back();
     }
-
-    class_attributes[current_class] = vector<pair<string, string> >();
+    path.push_back(i);
 
     // Basic classes should have no attributes.
     if (current_class == "Object" || current_class == "String" ||
@@ -295,10 +289,9 @@ void ClassTree::generate_class_attributes() {
       continue;
     } else {
       for (int j = 0; j < this->num_attributes_per_class; j++) {
-        // Choose attribute name/type.
-        string attribute_name = name_generator.generate(NameType::attribute, disallowed_attribute_names);
-        disallowed_attribute_names.push_back(attribute_name);
-        string attribute_type = possible_attribute_types[rand() % possible_attribute_types.size()];
+        // Choose attribute name/type. This reserves the name.
+        string attribute_name = name_generator.generate(NameType::attribute, reserved_names, rng);
+        string attribute_type = possible_attribute_types[rng.below(possible_attribute_types.size())];
 
         // Update data structures.
         class_attributes[current_class].push_back(pair<string, string>(attribute_name, attribute_type));
@@ -390,135 +383,245 @@ void ClassTree::generate_class_methods() {
   // Handle basic classes.
   add_basic_class_methods();
 
-  // Generate methods for each class.
-  for (int i = 0; i < class_names.size(); i++) {
+  // Names and declaring classes of the methods on the path from Object,
+  // kept as in generate_class_attributes. For simplicity, we don't allow
+  // any other method to be called main, even where it would be legal.
+  NameRegistry unavailable_names = NameRegistry();
+  unavailable_names.insert("main");
+  vector<pair<string, string> > redefinable_methods = vector<pair<string, string> >();
+  vector<int> path = vector<int>();
 
-    // Extract class, initialize data structures, skip basic classes.
+  // Generate methods for each class.
+  for (int p = 0; p < preorder_classes.size(); p++) {
+    int i = preorder_classes[p];
     string current_class = class_names[i];
-    if (current_class == "Object" || current_class == "IO" ||
-          current_class == "String" || current_class == "Int" ||
-          current_class == "Bool") continue;
-    class_method_names[current_class] = vector<string>();
-    class_method_types[current_class] = map<string, string>();
-    class_method_args[current_class] = map<string, vector<pair<string, string> > >();
-    
-    // We want to compute the names that we should not use if we 
-    // are not redefining a method. Thus, we must look at all parents
-    // and all children of the current class. For simplicity, we don't allow
-    // redefinition of the method main until it has been created in Main.
-    vector<string> unavailable_names = vector<string>();
-    unavailable_names.push_back("main");
-
-    // We will also update the method signatures that we can redefine.
-    vector<pair<string, string> > redefinable_methods = vector<pair<string, string> >();
-
-    // Iterate through ancestors.
-    vector<string> ancestors = class_ancestors[current_class];
-    for (int j = 0; j < ancestors.size(); j++) {
-      string ancestor = ancestors[j];
-      vector<string > ancestor_methods = class_method_names[ancestor];
-      for (int k = 0; k < ancestor_methods.size(); k++) {
-        string method_name = ancestor_methods[k];
-        unavailable_names.push_back(method_name);
-        pair<string, string> redefinable_method = pair<string, string>(method_name, current_class);
-        redefinable_methods.push_back(redefinable_method);
+
+    // Leave the subtrees that are done.
+    while (!path.empty() && path.back() != class_parent[i]) {
+      const vector<string>& done_methods = class_method_names[class_names[path.back()]];
+      for (int j = 0; j < done_methods.size(); j++) {
+        if (done_methods[j] != "main") unavailable_names.erase(done_methods[j]);
       }
+      redefinable_methods.resize(redefinable_methods.size() - done_methods.size());
+      path.pop_back();
     }
+    path.push_back(i);
 
-    // Iterate through descendants.
-    set<string> descendants = class_descendants[current_class];
-    for (set<string>::iterator it = descendants.begin(); it != descendants.end(); ++it) {
-      string descendant = *it;
-      vector<string> descendant_methods = class_method_names[descendant];
-      for (int k = 0; k < descendant_methods.size(); k++) {
-        string method_name = descendant_methods[k];
-        unavailable_names.push_back(method_name);
-        pair<string, string> redefinable_method = pair<string, string>(method_name, current_class);
-        redefinable_methods.push_back(redefinable_method);
-      }
+    // Basic classes already have their methods.
+    if (current_class != "Object" && current_class != "IO" &&
+          current_class != "String" && current_class != "Int" &&
+          current_class != "Bool") {
+      generate_methods_of(current_class, possible_types, unavailable_names, redefinable_methods);
     }
 
-    for (int j = 0; j < this->num_methods_per_class; j++) {
+    // Its methods are taken and can be redefined below it.
+    const vector<string>& current_methods = class_method_names[current_class];
+    for (int j = 0; j < current_methods.size(); j++) {
+      unavailable_names.insert(current_methods[j]);
+      redefinable_methods.push_back(pair<string, string>(current_methods[j], current_class));
+    }
+  }
+}
+
+// FUNCTION: Generates the methods of one (non-basic) class.
+// NOTE: @unavailable_names holds the method names of its ancestors, and
+//       @redefinable_methods their (name, declaring class) pairs.
+void ClassTree::generate_methods_of(const string& current_class,
+                                    const vector<string>& possible_types,
+                                    NameRegistry& unavailable_names,
+                                    const vector<pair<string, string> >& redefinable_methods) {
+  class_method_names[current_class] = vector<string>();
+  class_method_types[current_class] = map<string, string>();
+  class_method_args[current_class] = map<string, vector<pair<string, string> > >();
+
+  for (int j = 0; j < this->num_methods_per_class; j++) {
+
+    // Method generation.
+    // Case 1: main method inside Main class.
+    // Case 2: redefinition of method from some class.
+    // Case 3: creation of new method.
+    if (j == 0 && current_class == "Main") {
+      string method_name = "main";
+
+      // Choose return type.
+      string method_type = possible_types[rng.below(possible_types.size())];
+
+      // Update data structures.
+      class_method_names[current_class].push_back(method_name);
+      class_method_types[current_class][method_name] = method_type;
+      class_method_args[current_class][method_name] = vector<pair<string, string> >();
 
-      // Method generation.
-      // Case 1: main method inside Main class.
-      // Case 2: redefinition of method from some class.
-      // Case 3: creation of new method.
-      if (j == 0 && current_class == "Main") {
-        string method_name = "main";
+    } else {
+      if (rng.uniform() < this->probability_repeat_method_name) {
 
-        // Choose return type.
-        string method_type = possible_types[rand() % possible_types.size()];
+        // Choose method to redefine and extract information.
+        pair<string, string> method_to_redefine = redefinable_methods[rng.below(redefinable_methods.size())];
+        string method_name = method_to_redefine.first;
+        string method_type = class_method_types[method_to_redefine.second][method_name];
+        vector<pair<string, string> > method_redef_args = class_method_args[method_to_redefine.second][method_name];
 
         // Update data structures.
-        unavailable_names.push_back(method_name);
-        class_method_names[current_class].push_back(method_name);
         class_method_types[current_class][method_name] = method_type;
+
+        // Generate formals (keep return type the same as method_redef_args).
         class_method_args[current_class][method_name] = vector<pair<string, string> >();
+        vector<string> method_args = vector<string>();
+        for (int k = 0; k < method_redef_args.size(); k++) {
+          string argument_type = method_redef_args[k].second;
+          string argument_name = name_generator.generate(NameType::methodArgument, method_args, rng);
+          class_method_args[current_class][method_name].push_back(pair<string, string>(argument_name, argument_type));
+          method_args.push_back(argument_name);
+        }
 
       } else {
-        if ((double) rand() / (RAND_MAX) <= this->probability_repeat_method_name) {
-
-          // Choose method to redefine and extract information.
-          pair<string, string> method_to_redefine = redefinable_methods[rand() % redefinable_methods.size()];
-          string method_name = method_to_redefine.first;
-          string method_type = class_method_types[method_to_redefine.second][method_name];
-          vector<pair<string, string> > method_redef_args = class_method_args[method_to_redefine.second][method_name];
-
-          // Update data structures.
-          class_method_types[current_class][method_name] = method_type;
-
-          // Generate formals (keep return type the same as method_redef_args).
-          class_method_args[current_class][method_name] = vector<pair<string, string> >();
-          vector<string> method_args = vector<string>();
-          for (int k = 0; k < method_redef_args.size(); k++) {
-            string argument_type = method_redef_args[k].second;
-            string argument_name = name_generator.generate(NameType::methodArgument, method_args);
-            class_method_args[current_class][method_name].push_back(pair<string, string>(argument_name, argument_type));
-            method_args.push_back(argument_name);
-          }
-
-        } else {
-
-          // Generate method name/type.
-          string method_name = name_generator.generate(NameType::method, unavailable_names);
-          string method_type = possible_types[rand() % possible_types.size()];
-
-          // Update data structures.
-          unavailable_names.push_back(method_name);
-          class_method_names[current_class].push_back(method_name);
-          class_method_types[current_class][method_name] = method_type;
-          class_method_args[current_class][method_name] = vector<pair<string, string> >();
-
-          // Generate arguments.
-          vector<string> method_args = vector<string>();
-          int num_method_args = rand() % (max_num_method_args + 1);
-          for (int k = 0; k < num_method_args; k++) {
-            string argument_name = name_generator.generate(NameType::methodArgument, method_args);
-            method_args.push_back(argument_name);
-            string argument_type = class_names[rand() % class_names.size()];
-            class_method_args[current_class][method_name].push_back(pair<string, string>(argument_name, argument_type));
-          }
+
+        // Generate method name/type. This reserves the name.
+        string method_name = name_generator.generate(NameType::method, unavailable_names, rng);
+        string method_type = possible_types[rng.below(possible_types.size())];
+
+        // Update data structures.
+        class_method_names[current_class].push_back(method_name);
+        class_method_types[current_class][method_name] = method_type;
+        class_method_args[current_class][method_name] = vector<pair<string, string> >();
+
+        // Generate arguments.
+        vector<string> method_args = vector<string>();
+        int num_method_args = rng.below(max_num_method_args + 1);
+        for (int k = 0; k < num_method_args; k++) {
+          string argument_name = name_generator.generate(NameType::methodArgument, method_args, rng);
+          method_args.push_back(argument_name);
+          string argument_type = class_names[rng.below(class_names.size())];
+          class_method_args[current_class][method_name].push_back(pair<string, string>(argument_name, argument_type));
         }
       }
     }
   }
 }
 
+// FUNCTION: Flattens the generated methods into the method table.
+// NOTE: Redefinitions are only recorded in class_method_types and
+//       class_method_args, so a vtable slot always holds the declaration.
+void ClassTree::build_method_table() {
+  int num_total_classes = class_names.size();
+  method_names = vector<string>();
+  method_classes = vector<int>();
+  method_return_types = vector<int>();
+  method_arg_starts = vector<int>();
+  method_arg_names = vector<string>();
+  method_arg_types = vector<int>();
+  class_method_starts = vector<int>();
+
+  // Declared methods, by class.
+  for (int i = 0; i < num_total_classes; i++) {
+    class_method_starts.push_back(method_names.size());
+    const vector<string>& current_methods = class_method_names[class_names[i]];
+    map<string, string>& current_types = class_method_types[class_names[i]];
+    map<string, vector<pair<string, string> > >& current_args = class_method_args[class_names[i]];
+    for (int j = 0; j < current_methods.size(); j++) {
+      method_names.push_back(current_methods[j]);
+      method_classes.push_back(i);
+      method_return_types.push_back(class_id(current_types[current_methods[j]]));
+      method_arg_starts.push_back(method_arg_names.size());
+      const vector<pair<string, string> >& args = current_args[current_methods[j]];
+      for (int k = 0; k < args.size(); k++) {
+        method_arg_names.push_back(args[k].first);
+        method_arg_types.push_back(class_id(args[k].second));
+      }
+    }
+  }
+  class_method_starts.push_back(method_names.size());
+  method_arg_starts.push_back(method_arg_names.size());
+
+  // Vtables.
+  vtable_starts = vector<int>();
+  vtable_methods = vector<int>();
+  for (int i = 0; i < num_total_classes; i++) {
+    vtable_starts.push_back(vtable_methods.size());
+    for (int ancestor = i; ancestor != -1; ancestor = class_parent[ancestor]) {
+      for (int j = class_method_starts[ancestor]; j < class_method_starts[ancestor + 1]; j++) {
+        vtable_methods.push_back(j);
+      }
+    }
+  }
+  vtable_starts.push_back(vtable_methods.size());
+}
+
 // FUNCTION: Generates class information.
-void ClassTree::generate_class_information() {
-  generate_class_tree();
-  generate_class_attributes();
-	generate_class_methods();
+void ClassTree::generate_class_information(TraceBuffer* trace) {
+  if (trace) trace->begin("class_tree", "generate_class_tree");
+  generate_class_tree(trace);
+  if (trace) trace->end("\"classes\": " + to_string(class_names.size()));
+  run_phase(trace, "generate_class_attributes", &ClassTree::generate_class_attributes);
+  run_phase(trace, "generate_class_methods", &ClassTree::generate_class_methods);
+  run_phase(trace, "build_method_table", &ClassTree::build_method_table);
+}
+
+// FUNCTION: Returns the id of a class, or -1 if @name is not a class.
+int ClassTree::class_id(const string& name) const {
+  unordered_map<string, int>::const_iterator it = class_ids.find(name);
+  if (it == class_ids.end()) return -1;
+  return it->second;
+}
+
+// FUNCTION: Returns the name of a type id, with -1 for SELF_TYPE.
+const string& ClassTree::type_name(int type_id) const {
+  static const string self_type = "SELF_TYPE";
+  if (type_id == -1) return self_type;
+  return class_names[type_id];
+}
+
+// FUNCTION: Counts pairs (A, B) with A <= B <= @ancestor.
+// NOTE:  Every A below @ancestor pairs with each class on its path up to
+//        @ancestor, so A contributes class_depth[A] - class_depth[@ancestor] + 1.
+long long ClassTree::count_nested_pairs(int ancestor) const {
+  int first = class_preorder[ancestor];
+  int last = first + class_subtree_size[ancestor];
+  return preorder_depth_sums[last] - preorder_depth_sums[first]
+          - (long long) class_depth[ancestor] * class_subtree_size[ancestor];
+}
+
+// FUNCTION: Returns the @index-th pair (A, B) with A <= B <= @ancestor.
+// NOTE:  Pairs are ordered by the preorder position of A, then by the
+//        distance from A up to B.
+pair<int, int> ClassTree::nested_pair(int ancestor, long long index) const {
+  int first = class_preorder[ancestor];
+  long long base = preorder_depth_sums[first];
+  long long ancestor_depth = class_depth[ancestor];
+
+  // Find the last position whose preceding pairs number at most @index.
+  int low = first;
+  int high = first + class_subtree_size[ancestor] - 1;
+  while (low < high) {
+    int mid = low + (high - low + 1) / 2;
+    long long preceding = preorder_depth_sums[mid] - base - ancestor_depth * (mid - first);
+    if (preceding <= index) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  // Walk up from A to B.
+  int descendant = preorder_classes[low];
+  long long steps = index - (preorder_depth_sums[low] - base - ancestor_depth * (low - first));
+  int static_class = descendant;
+  for (long long i = 0; i < steps; i++) {
+    static_class = class_parent[static_class];
+  }
+  return pair<int, int>(descendant, static_class);
 }
 
 // FUNCTION: Checks if child <= parent.
 // NOTES: Input is assumed to not be SELF_TYPE.
-bool ClassTree::is_child_of(string child, string parent) {
+bool ClassTree::is_child_of(const string& child, const string& parent) const {
   if (child == parent) return true;
-  for (int i = 0; i < class_ancestors[child].size(); i++) {
-    string ancestor = class_ancestors[child][i];
-    if (ancestor == parent) return true;
-  }
-  return false;
+  return is_child_of(class_id(child), class_id(parent));
+}
+
+// FUNCTION: Checks if child <= parent, resolving SELF_TYPE through @current_class.
+bool ClassTree::is_child_of(const string& child, const string& parent,
+                            const string& current_class) const {
+  if (parent == "SELF_TYPE") return child == "SELF_TYPE";
+  if (child == "SELF_TYPE") return is_child_of(current_class, parent);
+  return is_child_of(child, parent);
 }
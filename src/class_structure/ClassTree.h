@@ -8,7 +8,11 @@
 #include <vector>
 #include <map>
 #include <set>
+#include <unordered_map>
 #include "NameGenerator.h"
+#include "NameRegistry.h"
+#include "Random.h"
+#include "Trace.h"
 
 // CLASS ClassTree
 // ---------------
@@ -35,9 +39,17 @@
 //    for debugging that prints the class internals. 
 //    
 // NOTES: - None of this class's structures include the special 
-//          values SELF_TYPE and self. These also cannot be input
-//          to the function is_child_of because it doesn't know the
-//          current class. 
+//          values SELF_TYPE and self. The two-argument is_child_of
+//          treats SELF_TYPE like any unknown name; use the overload
+//          that takes the current class to resolve it.
+//        - Once the tree is generated every class is given an id
+//          (its index in class_names) and pre/post-order numbers from
+//          a walk of the inheritance tree, so is_child_of is two
+//          integer comparisons. The classes <= C are then a
+//          contiguous range of preorder_classes, which stands in
+//          for a set of descendants.
+//        - Methods are also flattened into integer tables (see
+//          below), which is what code generation reads.
 //          
 class ClassTree {
 public:
@@ -64,17 +76,21 @@ public:
   //            Must be in the range [0,1]. This reflects the 
   //            probability that we repeat a method name (i.e., 
   //            method redefinition).
+  //    Random rng
+  //            The source of every random decision about the tree.
   ClassTree(const NameGenerator& name_generator,
             int num_classes,
             int num_attributes_per_class,
             int num_methods_per_class,
             int max_num_method_args,
-            float probability_repeat_method_name);
+            float probability_repeat_method_name,
+            const Random& rng);
 
   // FUNCTION: generate_class_information.
   // ------------------------------------
   // This populates the many data structures outlined below.
-  void generate_class_information();
+  // If @trace is given, each phase is recorded in it as a span.
+  void generate_class_information(TraceBuffer* trace = NULL);
 
   // FUNCTION: print_class_information.
   // ---------------------------------
@@ -92,30 +108,123 @@ public:
   //            Name of a class inside class_names.
   // Returns:
   //    True if child <= parent.
-  bool is_child_of(std::string child, std::string parent);
+  bool is_child_of(const std::string& child, const std::string& parent) const;
+
+  // FUNCTION: is_child_of
+  // ---------------------
+  // Checks if child <= parent where either may be SELF_TYPE.
+  // SELF_TYPE as the child is resolved to current_class, and
+  // nothing but SELF_TYPE conforms to SELF_TYPE.
+  bool is_child_of(const std::string& child, const std::string& parent,
+                   const std::string& current_class) const;
+
+  // FUNCTION: is_child_of
+  // ---------------------
+  // Checks if child <= parent by class id. Negative ids (unknown
+  // names) never conform.
+  bool is_child_of(int child, int parent) const {
+    return child >= 0 && parent >= 0 &&
+           class_preorder[parent] <= class_preorder[child] &&
+           class_postorder[child] <= class_postorder[parent];
+  }
+
+  // FUNCTION: subtype
+  // -----------------
+  // Returns the id of the index-th class C <= ancestor, for index
+  // in [0, class_subtree_size[ancestor]). Index 0 is @ancestor.
+  int subtype(int ancestor, int index) const {
+    return preorder_classes[class_preorder[ancestor] + index];
+  }
+
+  // FUNCTION: count_nested_pairs
+  // ---------------------------
+  // Returns the number of pairs of classes (A, B) with
+  // A <= B <= ancestor. This is the number of static
+  // dispatches (A)@B that conform to ancestor.
+  long long count_nested_pairs(int ancestor) const;
+
+  // FUNCTION: nested_pair
+  // ---------------------
+  // Returns the index-th pair (A, B) with A <= B <= ancestor,
+  // for index in [0, count_nested_pairs(ancestor)).
+  std::pair<int, int> nested_pair(int ancestor, long long index) const;
+
+  // FUNCTION: type_name
+  // -------------------
+  // Returns the name of the class with id @type_id, or SELF_TYPE
+  // for -1.
+  const std::string& type_name(int type_id) const;
+
+  // FUNCTION: class_id
+  // ------------------
+  // Returns the index of @name in class_names, or -1 if it is
+  // not a class (e.g. SELF_TYPE).
+  int class_id(const std::string& name) const;
 
   // Data structures for class tree information.
   // NOTE: Most maps are intuitive, but we record their official definitions here.
   //    class_names       : vector of class names as strings
-  //    class_ancestors   : map from class name to ordered vector of ancestors
-  //    class_descendants : map from class name to set of all children
   //    class_attributes  : map from class name to vector of (name, type) pairs
   //    class_method_names: map from class name to vector of names
   //    class_method_types: map from class name to map from method name to method type
   //    class_method_args : map from class name to map of method name -> vector of (arg name, arg type)
+  //    class_ids         : map from class name to its index in class_names
+  //    class_preorder    : class index -> position in a preorder walk of the tree
+  //    class_postorder   : class index -> position in a postorder walk of the tree
+  //    class_parent      : class index -> index of its parent (-1 for Object);
+  //                        following it from a class visits its ancestors in order
+  //    class_depth       : class index -> number of ancestors
+  //    class_subtree_size: class index -> number of classes <= it (itself included)
+  //    preorder_classes  : preorder position -> class index, so the classes <= C
+  //                        are the class_subtree_size[C] entries from class_preorder[C]
+  //    preorder_depth_sums: prefix sums of (class_depth + 1) over preorder_classes
   std::vector<std::string> class_names;
-  std::map<std::string, std::vector<std::string> > class_ancestors;
-  std::map<std::string, std::set<std::string> > class_descendants;
   std::map<std::string, std::vector<std::pair<std::string, std::string> > > class_attributes;
   std::map<std::string, std::vector<std::string > > class_method_names;
   std::map<std::string, std::map<std::string, std::string> > class_method_types;
   std::map<std::string, std::map<std::string, std::vector<std::pair<std::string, std::string> > > > class_method_args;
+  std::unordered_map<std::string, int> class_ids;
+  std::vector<int> class_preorder;
+  std::vector<int> class_postorder;
+  std::vector<int> class_parent;
+  std::vector<int> class_depth;
+  std::vector<int> class_subtree_size;
+  std::vector<int> preorder_classes;
+  std::vector<long long> preorder_depth_sums;
+
+  // Method table, built once the methods are generated.
+  // NOTE: Methods are numbered by declaring class, in class id order, so
+  //       the methods declared in class C have the ids in
+  //       [class_method_starts[C], class_method_starts[C + 1]). Only
+  //       methods in class_method_names get an id.
+  //    method_names       : method id -> name
+  //    method_classes     : method id -> id of the class declaring it
+  //    method_return_types: method id -> id of its return type (-1 for SELF_TYPE)
+  //    method_arg_starts  : method id -> index of its first formal in
+  //                         method_arg_names/method_arg_types (one extra entry at the end)
+  //    method_arg_names   : formal names, grouped by method
+  //    method_arg_types   : formal type ids, grouped by method
+  //    class_method_starts: class id -> first method id declared there (one extra entry)
+  //    vtable_starts      : class id -> index of its first entry in vtable_methods
+  //                         (one extra entry at the end)
+  //    vtable_methods     : the ids of every method a class can call on self: its
+  //                         own, then its parent's, and so on up to Object
+  std::vector<std::string> method_names;
+  std::vector<int> method_classes;
+  std::vector<int> method_return_types;
+  std::vector<int> method_arg_starts;
+  std::vector<std::string> method_arg_names;
+  std::vector<int> method_arg_types;
+  std::vector<int> class_method_starts;
+  std::vector<int> vtable_starts;
+  std::vector<int> vtable_methods;
 
 private:
 
   // Internal methods for generate_class_information().
   // These should be called in the following order.
-  void generate_class_tree();
+  void generate_class_tree(TraceBuffer* trace);
+  void run_phase(TraceBuffer* trace, const char* name, void (ClassTree::*phase)());
   void generate_class_attributes();
   void generate_class_methods();
 
@@ -124,8 +233,12 @@ private:
   void generate_class_names();
   void generate_inheritance();
   void add_basic_classes();
-  void update_ancestor_vectors(std::string child, std::string parent);
-  void update_child_sets(std::string child, std::string parent);
+  void number_classes();
+  void build_method_table();
+  void generate_methods_of(const std::string& current_class,
+                           const std::vector<std::string>& possible_types,
+                           NameRegistry& unavailable_names,
+                           const std::vector<std::pair<std::string, std::string> >& redefinable_methods);
 
   // Parameters for class generation.
   const NameGenerator& name_generator;
@@ -134,6 +247,7 @@ private:
   int num_methods_per_class;
   int max_num_method_args;
   float probability_repeat_method_name;
+  Random rng;
 };
 
 #endif
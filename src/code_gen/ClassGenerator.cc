@@ -0,0 +1,399 @@
+// File       : ClassGenerator.cc
+// Description: Implementation of the generation of one COOL class.
+
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include "ClassGenerator.h"
+#include "CodeGenerator.h"
+
+using namespace std;
+
+int spaces_per_tab = 4; // Used to keep track of line length.
+
+// The expansions, indexed by ExpansionType (keep the order of the enum).
+const ExpansionDescriptor ClassGenerator::expansion_registry[NUM_EXPRESSION_TYPES] = {
+  {New, "New", ANY_CATEGORY, 0, 1.0,
+    &ClassGenerator::generate_new, &ClassGenerator::print_new},
+  {Bool, "Bool", CATEGORY(BoolType) | CATEGORY(ObjectType), 0, 1.0,
+    &ClassGenerator::generate_bool, &ClassGenerator::print_bool},
+  {String, "String", CATEGORY(StringType) | CATEGORY(ObjectType), 0, 1.0,
+    &ClassGenerator::generate_string, &ClassGenerator::print_string},
+  {Int, "Int", CATEGORY(IntType) | CATEGORY(ObjectType), 0, 1.0,
+    &ClassGenerator::generate_int, &ClassGenerator::print_int},
+  {Identifier, "Identifier", ANY_CATEGORY, FEASIBLE_IDENTIFIER, 1.0,
+    &ClassGenerator::generate_identifier, &ClassGenerator::print_identifier},
+  {Assignment, "Assignment", ANY_CATEGORY, WITHIN_BUDGET | FEASIBLE_ASSIGNMENT, 1.0,
+    &ClassGenerator::generate_assignment, &ClassGenerator::print_assignment},
+  {Dispatch, "Dispatch", ANY_CATEGORY, WITHIN_BUDGET | FEASIBLE_DISPATCH, 1.0,
+    &ClassGenerator::generate_dispatch, &ClassGenerator::print_dispatch},
+  {StaticDispatch, "StaticDispatch", ANY_CATEGORY, WITHIN_BUDGET | FEASIBLE_STATIC_DISPATCH, 1.0,
+    &ClassGenerator::generate_dispatch, &ClassGenerator::print_dispatch},
+  {SelfDispatch, "SelfDispatch", ANY_CATEGORY, WITHIN_BUDGET | FEASIBLE_SELF_DISPATCH, 1.0,
+    &ClassGenerator::generate_dispatch, &ClassGenerator::print_dispatch},
+  {Conditional, "Conditional", ANY_CATEGORY, WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_conditional, &ClassGenerator::print_conditional},
+  {Loop, "Loop", CATEGORY(ObjectType), WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_loop, &ClassGenerator::print_loop},
+  {Block, "Block", ANY_CATEGORY, WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_block, &ClassGenerator::print_block},
+  {IsVoid, "IsVoid", CATEGORY(BoolType) | CATEGORY(ObjectType), WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_isvoid, &ClassGenerator::print_isvoid},
+  {Arithmetic, "Arithmetic", CATEGORY(IntType) | CATEGORY(ObjectType), WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_arithmetic, &ClassGenerator::print_arithmetic},
+  {Comparison, "Comparison", CATEGORY(BoolType) | CATEGORY(ObjectType), WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_comparison, &ClassGenerator::print_comparison},
+  {IntComplement, "IntComplement", CATEGORY(IntType) | CATEGORY(ObjectType), WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_int_complement, &ClassGenerator::print_int_complement},
+  {BoolComplement, "BoolComplement", CATEGORY(BoolType) | CATEGORY(ObjectType), WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_bool_complement, &ClassGenerator::print_bool_complement},
+  {Let, "Let", ANY_CATEGORY, WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_let, &ClassGenerator::print_let},
+  {Case, "Case", ANY_CATEGORY, WITHIN_BUDGET, 1.0,
+    &ClassGenerator::generate_case, &ClassGenerator::print_case}
+};
+
+// FUNCTION: Constructor.
+ClassGenerator::ClassGenerator(const CodeGenerator& code_generator, int thread)
+    : max_recursion_depth(code_generator.max_recursion_depth)
+    , max_block_length(code_generator.max_block_length)
+    , max_let_defines(code_generator.max_let_defines)
+    , max_case_branches(code_generator.max_case_branches)
+    , max_line_length(code_generator.max_line_length)
+    , max_expression_count(code_generator.max_expression_count)
+    , probability_initialized(code_generator.probability_initialized)
+    , self_type_bucket(code_generator.self_type_bucket)
+    , name_generator(code_generator.name_generator)
+    , tree(code_generator.tree)
+    , expansion_sets(code_generator.expansion_sets)
+    , expansion_tables(code_generator.expansion_tables)
+    , expansion_checks(code_generator.expansion_checks)
+    , type_dispatch_index(code_generator.type_dispatch_index)
+    , identifiers(code_generator.identifier_bucket_types, code_generator.identifier_bucket_ends)
+    , tracing(code_generator.trace_writer != nullptr)
+    , trace_expressions(tracing && code_generator.trace_expressions)
+    , trace(thread) {
+
+  // Initialization of internal state.
+  this->current_line_length = 0;
+  this->indentation_tabs = 0;
+  this->recursive_depth = 0;
+  this->num_frames = 0;
+  this->num_symbols = 0;
+  this->expression_count = 0;
+  this->current_class_id = -1;
+}
+
+// FUNCTION: Generates @class_name into the output buffer, drawing
+// every random decision from @rng.
+void ClassGenerator::generate_class(string class_name, const Random& rng) {
+  writer.clear();
+  this->rng = rng;
+  expression_count = 0;
+  recursive_depth = 0;
+  num_frames = 0;
+  print_frames.clear();
+  stats = GenerationStats();
+  print_class(class_name);
+}
+
+// FUNCTION: Runs @frame's expansion until it pushes a subexpression or
+//  is done, and returns whether it pushed one. This is different from
+//  generate_expression in the sense that the frame holds a type of
+//  expression expansion. For example, "dispatch" is a type of
+//  expansion, and it may evaluate to an expression of type "Int".
+// NOTES: - @frame may move when a subexpression is pushed, so nothing
+//          reads it after the call that pushes.
+bool ClassGenerator::generate_expansion(ExpressionFrame& frame) {
+  return (this->*expansion_registry[frame.node->expansion].generate)(frame);
+}
+
+// FUNCTION: Computes the expansion signature for an expression of the given type.
+//  Only the feasibility checks that matter are run: those that some
+//  expansion with positive weight for the type category needs, and
+//  none that need budget when there is none left.
+int ClassGenerator::expansion_signature(string expression_type) {
+
+  // Type category.
+  int category = OtherType;
+  if (expression_type == "Bool") {
+    category = BoolType;
+  } else if (expression_type == "Int") {
+    category = IntType;
+  } else if (expression_type == "String") {
+    category = StringType;
+  } else if (expression_type == "Object") {
+    category = ObjectType;
+  } else if (expression_type == "SELF_TYPE") {
+    category = SelfType;
+  }
+
+  // Feasibility bits.
+  int checks = expansion_checks[category];
+  int mask = 0;
+  if ((checks & FEASIBLE_IDENTIFIER) && generate_identifier(expression_type, true)) {
+    mask |= FEASIBLE_IDENTIFIER;
+  }
+  if (recursive_depth < max_recursion_depth && expression_count < max_expression_count) {
+    mask |= WITHIN_BUDGET;
+    if ((checks & FEASIBLE_ASSIGNMENT) && generate_assignment(expression_type, true)) {
+      mask |= FEASIBLE_ASSIGNMENT;
+    }
+    if (checks & (FEASIBLE_SELF_DISPATCH | FEASIBLE_STATIC_DISPATCH | FEASIBLE_DISPATCH)) {
+      count_dispatches(expression_type);
+      if (self_dispatch_count != 0) mask |= FEASIBLE_SELF_DISPATCH;
+      if (static_dispatch_count != 0) mask |= FEASIBLE_STATIC_DISPATCH;
+      if (dispatch_count != 0) mask |= FEASIBLE_DISPATCH;
+    }
+  }
+
+  return category * NUM_FEASIBILITY_MASKS + mask;
+}
+
+// FUNCTION: Generates an expression of the given type and returns its tree.
+// NOTES: - Expressions are pushed on the frames stack and resumed until
+//          this one is done, instead of recursing: the work, and the
+//          order of every random draw, is that of a depth-first
+//          recursion, but only heap memory grows with the depth.
+ExpressionNode* ClassGenerator::generate_expression(string expression_type) {
+  int base = num_frames;
+  ExpressionNode* root = push_expression(expression_type);
+  while (num_frames > base) {
+    if (!generate_expansion(frames[num_frames - 1])) {
+
+      // Reduce recursive depth.
+      num_frames--;
+      recursive_depth--;
+    }
+  }
+  return root;
+}
+
+// FUNCTION: Chooses an expansion for an expression of the given type,
+// pushes its frame and returns its node. It runs from the next
+// generate_expansion call on.
+ExpressionNode* ClassGenerator::push_expression(string expression_type) {
+
+  // Increase recursive depth.
+  recursive_depth++;
+
+  // Increase expression count.
+  expression_count++;
+
+  // Choose expansion from the alias table for this signature.
+  int signature = expansion_signature(expression_type);
+  const AliasTable& table = expansion_tables[signature];
+  if (table.size() == 0) {
+    throw "No expansion with positive weight can produce an expression of type " + expression_type + ".";
+  }
+  ExpansionType expansion = expansion_sets[signature][table.sample(rng.uniform())];
+
+  // Statistics. Depth 0 is the outermost expression.
+  stats.expansions[expansion]++;
+  if (stats.depths.size() < recursive_depth) stats.depths.resize(recursive_depth, 0);
+  stats.depths[recursive_depth - 1]++;
+  stats.max_identifiers = max(stats.max_identifiers, (long long) identifiers.size());
+  stats.max_scopes = max(stats.max_scopes, (long long) identifiers.num_scopes());
+
+  // Push the frame, reusing an old one's memory if there is one.
+  ExpressionNode* node = arena.make<ExpressionNode>();
+  node->expansion = expansion;
+  if (num_frames == frames.size()) frames.push_back(ExpressionFrame());
+  ExpressionFrame& frame = frames[num_frames++];
+  frame.node = node;
+  frame.type.swap(expression_type);
+  frame.step = 0;
+  frame.index = 0;
+  frame.types.clear();
+  return node;
+}
+
+// FUNCTION: Gives @frame's node @num_children empty children.
+void ClassGenerator::add_children(ExpressionFrame& frame, int num_children) {
+  frame.node->num_children = num_children;
+  frame.node->children = arena.make_array<ExpressionNode*>(num_children);
+}
+
+// FUNCTION: Pushes the next of @frame's children, of the type in
+// frame.types, and returns true, or returns false if there is none left.
+bool ClassGenerator::push_next_child(ExpressionFrame& frame) {
+  if (frame.index == frame.node->num_children) return false;
+  ExpressionNode* node = frame.node;
+  int i = frame.index++;
+  node->children[i] = push_expression(frame.types[i]);
+  return true;
+}
+
+// FUNCTION: Stores @name for printing and returns its symbol id.
+int ClassGenerator::add_symbol(const string& name) {
+  if (num_symbols == symbols.size()) symbols.push_back(string());
+  symbols[num_symbols] = name;
+  return num_symbols++;
+}
+
+// FUNCTION: Generates an attribute initializer or a method body and
+// prints it, recording it as a span if top-level expressions are traced.
+// NOTES: The arena and symbols only hold this expression, so they are
+//        reset before it.
+void ClassGenerator::generate_top_expression(string expression_type) {
+  int first_expression = expression_count;
+  if (trace_expressions) trace.begin("expression", expression_type);
+  arena.reset();
+  num_symbols = 0;
+  ExpressionNode* root = generate_expression(expression_type);
+  print_expression(root);
+  if (trace_expressions) {
+    trace.end("\"expressions\": " + to_string(expression_count - first_expression) +
+              ", \"arena_bytes\": " + to_string(arena.bytes_used()));
+  }
+}
+
+// FUNCTION: Prints the number of tabs indicated by global indentation_tabs.
+// NOTES: - This should only be used on a new line. Otherwise, current_line_length
+//          will be incorrect.
+void ClassGenerator::print_tabs() {
+  current_line_length = indentation_tabs * spaces_per_tab;
+  writer << string(indentation_tabs, '\t');
+}
+
+// FUNCTION: Prints one attribute.
+void ClassGenerator::print_attribute(string class_name, string attribute_name, string attribute_type) {
+  print_tabs();
+  indentation_tabs++;
+
+  writer << attribute_name << ": " << attribute_type;
+  current_line_length += attribute_name.length() + attribute_type.length() + 2;
+
+  // Generate initialization based on initialization probability.
+  if (rng.uniform() >= probability_initialized) {
+    writer << ";" << '\n';
+  } else {
+    writer << " <- (";
+    current_line_length += 5;
+    generate_top_expression(attribute_type);
+    writer << ");" << '\n';
+  }
+
+  indentation_tabs--;
+}
+
+// FUNCTION: Prints one method.
+// NOTES: Handles updating the identifiers vector with
+//        all the arguments in one method.
+void ClassGenerator::print_method(int method_id) {
+  const string& method_name = tree.method_names[method_id];
+  const string& method_type = tree.type_name(tree.method_return_types[method_id]);
+  int first_arg = tree.method_arg_starts[method_id];
+  int last_arg = tree.method_arg_starts[method_id + 1];
+  int first_expression = expression_count;
+  if (tracing) trace.begin("method", current_class + "." + method_name);
+
+  // Update identifiers.
+  identifiers.enter_scope();
+  for (int i = first_arg; i < last_arg; i++) {
+    identifiers.add_id(tree.method_arg_names[i], tree.class_names[tree.method_arg_types[i]]);
+  }
+
+  // Tabs + method name.
+  print_tabs();
+  writer << method_name << "(";
+
+  // Print arguments.
+  for (int i = first_arg; i < last_arg; i++) {
+    writer << tree.method_arg_names[i] << ": " << tree.class_names[tree.method_arg_types[i]];
+    if (i != last_arg - 1) writer << ", ";
+  }
+
+  // Print return type.
+  writer << ") : " << method_type << " {" << '\n';
+  indentation_tabs++;
+
+  // Generate body.
+  print_tabs();
+  generate_top_expression(method_type);
+  writer << '\n';
+
+  // End method declaration.
+  indentation_tabs--;
+  print_tabs();
+  writer << "};" << '\n';
+
+  // Remove arguments from identifiers.
+  identifiers.exit_scope();
+  if (tracing) {
+    trace.end("\"arguments\": " + to_string(last_arg - first_arg) +
+              ", \"expressions\": " + to_string(expression_count - first_expression));
+  }
+}
+
+// FUNCTION: Prints one class.
+// NOTES: - updates identifiers vectors with attributes + self.
+//        - updates current_class as well.
+void ClassGenerator::print_class(string class_name) {
+
+  current_class = class_name;
+  current_class_id = tree.class_id(class_name);
+  if (tracing) trace.begin("class", class_name);
+
+  self_dispatch_counts = map<int, long long>();
+
+  // Update identifiers vector with local variables.
+  vector<string> attribute_holders = vector<string>();
+  for (int ancestor = tree.class_parent[current_class_id]; ancestor != -1;
+       ancestor = tree.class_parent[ancestor]) {
+    attribute_holders.push_back(tree.class_names[ancestor]);
+  }
+  attribute_holders.push_back(class_name);
+  for (int i = 0; i < attribute_holders.size(); i++) {
+    map<string, vector<pair<string, string> > >::const_iterator attributes =
+      tree.class_attributes.find(attribute_holders[i]);
+    if (attributes == tree.class_attributes.end()) continue;
+    const vector<pair<string, string> >& current_attribute_pairs = attributes->second;
+    for (int j = 0; j < current_attribute_pairs.size(); j++) {
+      identifiers.add_id(current_attribute_pairs[j].first, current_attribute_pairs[j].second);
+    }
+  }
+  identifiers.add_id("self", class_name);
+
+  // Print class declaration line.
+  string parent = tree.class_names[tree.class_parent[current_class_id]];
+  print_tabs();
+  if (parent == "Object") {
+    writer << "class " << class_name << " {" << '\n';
+  } else {
+    writer << "class " << class_name << " inherits " << parent << " {" << '\n';
+  }
+  indentation_tabs++;
+
+  // Print attributes.
+  const vector<pair<string, string> >& class_attributes = tree.class_attributes.at(class_name);
+  for (int i = 0; i < class_attributes.size(); i++) {
+    string attribute_name = class_attributes[i].first;
+    string attribute_type = class_attributes[i].second;
+    print_attribute(class_name, attribute_name, attribute_type);
+  }
+
+  // One line between methods and attributes.
+  writer << '\n';
+
+  // Print methods.
+  for (int i = tree.class_method_starts[current_class_id];
+       i < tree.class_method_starts[current_class_id + 1]; i++) {
+    print_method(i);
+  }
+
+  // Print class end.
+  indentation_tabs--;
+  print_tabs();
+  writer << "};" << '\n' << '\n';
+
+  // Reset identifiers vector.
+  identifiers.exit_scope();
+  if (tracing) {
+    trace.end("\"id\": " + to_string(current_class_id) +
+              ", \"depth\": " + to_string(tree.class_depth[current_class_id]) +
+              ", \"expressions\": " + to_string(expression_count));
+  }
+}
+
@@ -0,0 +1,312 @@
+// File       : ClassGenerator.h
+// Description: File for generating the body of one COOL class.
+
+#ifndef CLASSGENERATOR_H_
+#define CLASSGENERATOR_H_
+
+#include <map>
+#include <string>
+#include <vector>
+#include "CodeGenerator.h"
+#include "ClassTree.h"
+#include "SymbolTable.h"
+#include "NameGenerator.h"
+#include "AliasTable.h"
+#include "OutputWriter.h"
+#include "Random.h"
+#include "Trace.h"
+#include "Arena.h"
+
+// STRUCT ExpressionNode
+// ---------------------
+// A generated expression, before it is printed. Nodes and the arrays
+// they point to live in the ClassGenerator's arena until the top-level
+// expression they belong to has been printed.
+//    expansion : how the expression was expanded
+//    type      : the class of a new, the static type of a static
+//                dispatch (class ids, -1 for SELF_TYPE)
+//    value     : the Bool (0 or 1) or Int constant, the symbol of a String
+//                constant or (assigned) identifier, the method of a
+//                dispatch, the operator of arithmetic and comparisons
+//    children  : subexpressions in the order they are printed; a let has
+//                one per define (NULL if not initialized), then its body
+//    bindings  : let and case variables as (symbol, type id) pairs
+struct ExpressionNode {
+  ExpansionType expansion;
+  int type;
+  int value;
+  int num_children;
+  ExpressionNode** children;
+  int num_bindings;
+  int* bindings;
+};
+
+// STRUCT ExpressionFrame
+// ----------------------
+// An expression being generated, on the ClassGenerator's work stack.
+// Expansions with subexpressions are state machines: they push a
+// subexpression and resume at @step once it is done. What they chose
+// before that is kept in @node, or here if it only matters later.
+//    type       : the type the expression must conform to
+//    index      : the next subexpression to push
+//    types      : subexpression types chosen up front
+struct ExpressionFrame {
+  ExpressionNode* node;
+  std::string type;
+  int step;
+  int index;
+  std::vector<std::string> types;
+};
+
+// STRUCT PrintFrame
+// -----------------
+// An expression being printed, on the ClassGenerator's print stack.
+// Like generation, printing resumes at @step once the subexpression
+// it pushed is printed.
+//    index   : the next child (or define, argument, branch) to print
+//    wrapped : whether the pending part is printed on its own line(s)
+struct PrintFrame {
+  const ExpressionNode* node;
+  int step;
+  int index;
+  bool wrapped;
+};
+
+class ClassGenerator;
+
+// STRUCT ExpansionDescriptor
+// --------------------------
+// Everything about one expansion that isn't in its generate and
+// print functions. CodeGenerator builds its alias tables from these
+// and ClassGenerator dispatches through them, so adding an expansion
+// means adding a descriptor, not another branch.
+//    name       : its name in statistics
+//    categories : the type categories it can produce (TypeCategory bits)
+//    requires   : the feasibility bits it needs (FEASIBLE_* and WITHIN_BUDGET)
+//    weight     : its default weight
+//    generate   : fills in a node (see generate_expansion)
+//    print      : prints a node (see print_expansion)
+struct ExpansionDescriptor {
+  ExpansionType expansion;
+  const char* name;
+  int categories;
+  int requires;
+  float weight;
+  bool (ClassGenerator::*generate)(ExpressionFrame& frame);
+  bool (ClassGenerator::*print)(PrintFrame& frame);
+};
+
+// CLASS ClassGenerator
+// --------------------
+// Generates the attributes and methods of one class at a
+// time into an in-memory buffer. Everything it reads from
+// the CodeGenerator is read-only, so several ClassGenerators
+// can run on different threads at once.
+//
+// Usage:
+//    Construct from a CodeGenerator, then call generate_class
+//    for each class and read the result back from output
+//    before the next call.
+//
+// NOTES: - A class's output only depends on the class and the
+//          random stream it is generated with, not on which classes
+//          this generator has seen before.
+//        - Each attribute initializer and method body is first built as
+//          a tree of ExpressionNodes in an arena, then printed, and the
+//          arena is reset. Line lengths and indentation only matter to
+//          printing and no random draw depends on them.
+//        - Expressions are generated and printed from explicit stacks
+//          of frames rather than by recursion, so the recursion depth
+//          limit only costs heap memory, not native stack.
+//        - When the CodeGenerator is tracing, spans are recorded in
+//          trace_spans instead of being written, since several
+//          generators run at once.
+class ClassGenerator {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    CodeGenerator code_generator
+  //        The generator holding the class tree. It must outlive
+  //        this object.
+  //    Int thread
+  //        The thread id trace spans are recorded under.
+  ClassGenerator(const CodeGenerator& code_generator, int thread = 0);
+
+  // FUNCTION generate_class
+  // -----------------------
+  // Parameters:
+  //    String class_name
+  //        The class to generate.
+  //    Random rng
+  //        The random stream of this class.
+  //
+  // Replaces output with the code for @class_name.
+  void generate_class(std::string class_name, const Random& rng);
+
+  // FUNCTION output
+  // ---------------
+  // Returns the code of the last generated class.
+  const OutputBuffer& output() const { return writer; }
+
+  // FUNCTION expressions
+  // --------------------
+  // Returns the number of expressions in the last generated class.
+  int expressions() const { return expression_count; }
+
+  // FUNCTION statistics
+  // -------------------
+  // Returns the statistics of the last generated class.
+  const GenerationStats& statistics() const { return stats; }
+
+  // FUNCTION trace_spans
+  // --------------------
+  // Returns the spans recorded since they were last taken out,
+  // if the CodeGenerator is tracing. Callers swap them out.
+  TraceBuffer& trace_spans() { return trace; }
+
+  // The expansions, indexed by ExpansionType.
+  static const ExpansionDescriptor expansion_registry[NUM_EXPRESSION_TYPES];
+
+private:
+
+  // Internal functions for generate_class();
+  ExpressionNode* generate_expression(std::string type);
+  void generate_top_expression(std::string type);
+  void print_class(std::string class_name);
+  void print_attribute(std::string class_name, std::string attribute_name, std::string attribute_type);
+  void print_method(int method_id);
+  void print_tabs();
+
+  // Expression generation. The generate_* functions of expansions with
+  // subexpressions return true when they pushed one (and must then not
+  // touch their frame, which the push may move), false when done.
+  ExpressionNode* push_expression(std::string type);
+  bool generate_expansion(ExpressionFrame& frame);
+  int expansion_signature(std::string expression_type);
+  void add_children(ExpressionFrame& frame, int num_children);
+  bool push_next_child(ExpressionFrame& frame);
+  int add_symbol(const std::string& name);
+  bool generate_new(ExpressionFrame& frame);
+  bool generate_bool(ExpressionFrame& frame);
+  bool generate_string(ExpressionFrame& frame);
+  bool generate_int(ExpressionFrame& frame);
+  bool generate_identifier(ExpressionFrame& frame);
+  bool generate_identifier(std::string type, bool abort_early);
+  bool generate_assignment(ExpressionFrame& frame);
+  bool generate_assignment(std::string type, bool abort_early);
+  int assign_types_for(int identifier_type, int type);
+  bool add_assignment(std::string identifier, std::string assign_type);
+  std::string choose_subtype(std::string type);
+  std::string random_type();
+  void count_dispatches(std::string type);
+  bool self_dispatch_conforms(int method_index, int type_id);
+  int nth_self_dispatch(int type_id, long long n);
+  bool generate_dispatch(ExpressionFrame& frame);
+  bool generate_conditional(ExpressionFrame& frame);
+  bool generate_loop(ExpressionFrame& frame);
+  bool generate_block(ExpressionFrame& frame);
+  bool generate_isvoid(ExpressionFrame& frame);
+  bool generate_arithmetic(ExpressionFrame& frame);
+  bool generate_comparison(ExpressionFrame& frame);
+  bool generate_bool_complement(ExpressionFrame& frame);
+  bool generate_int_complement(ExpressionFrame& frame);
+  bool generate_let(ExpressionFrame& frame);
+  bool generate_case(ExpressionFrame& frame);
+
+  // Expression printing. The print_* functions of expansions with
+  // subexpressions return true when they pushed one (and must then not
+  // touch their frame), false when done.
+  void print_expression(const ExpressionNode* root);
+  void push_print(const ExpressionNode* node);
+  bool print_expansion(PrintFrame& frame);
+  bool wrap_if_full(bool indent);
+  void unwrap(bool wrapped, bool indent);
+  bool print_new(PrintFrame& frame);
+  bool print_bool(PrintFrame& frame);
+  bool print_string(PrintFrame& frame);
+  bool print_int(PrintFrame& frame);
+  bool print_identifier(PrintFrame& frame);
+  bool print_assignment(PrintFrame& frame);
+  bool print_dispatch(PrintFrame& frame);
+  bool print_conditional(PrintFrame& frame);
+  bool print_loop(PrintFrame& frame);
+  bool print_block(PrintFrame& frame);
+  bool print_isvoid(PrintFrame& frame);
+  bool print_arithmetic(PrintFrame& frame);
+  bool print_comparison(PrintFrame& frame);
+  bool print_binary(PrintFrame& frame, const char* operation);
+  bool print_int_complement(PrintFrame& frame);
+  bool print_bool_complement(PrintFrame& frame);
+  bool print_unary(PrintFrame& frame, const char* prefix);
+  bool print_let(PrintFrame& frame);
+  bool print_case(PrintFrame& frame);
+
+  // Configuration, copied from the CodeGenerator.
+  int max_recursion_depth;
+  int max_block_length;
+  int max_let_defines;
+  int max_case_branches;
+  int max_line_length;
+  int max_expression_count;
+  float probability_initialized;
+  int self_type_bucket;
+
+  // Shared with the CodeGenerator (read-only).
+  const NameGenerator& name_generator;
+  const ClassTree& tree;
+  const std::vector<std::vector<ExpansionType> >& expansion_sets;
+  const std::vector<AliasTable>& expansion_tables;
+  const std::vector<int>& expansion_checks;
+  const std::vector<TypeDispatches>& type_dispatch_index;
+
+  // Variables used internally.
+  OutputBuffer writer;
+  Random rng;
+  SymbolTable identifiers;  // Bucketed by class in preorder, then SELF_TYPE.
+  std::string current_class;
+  int current_line_length; // Currently only updated for expression printing.
+  int recursive_depth;
+  int expression_count;
+  int indentation_tabs;
+  GenerationStats stats;
+
+  // Expression trees of the current top-level expression.
+  //    arena   : holds the nodes
+  //    symbols : symbol id -> identifier name or String constant; entries
+  //              past num_symbols are kept to reuse their memory
+  Arena arena;
+  std::vector<std::string> symbols;
+  int num_symbols;
+
+  // Work stack of expressions being generated. Frames past num_frames
+  // are kept to reuse their memory.
+  std::vector<ExpressionFrame> frames;
+  int num_frames;
+
+  // Work stack of expressions being printed.
+  std::vector<PrintFrame> print_frames;
+
+  // Tracing. Spans are recorded for each class and method, and with
+  // trace_expressions for each attribute initializer and method body.
+  bool tracing;
+  bool trace_expressions;
+  TraceBuffer trace;
+
+  // Internal dispatch structures.
+  // NOTE: count_dispatches only counts the candidates for the expression
+  //       being generated; generate_dispatch draws one straight from the
+  //       class hierarchy once a dispatch has been chosen.
+  //         self_dispatch_counts : type id -> self dispatch count in the current class
+  int current_class_id;
+  std::map<int, long long> self_dispatch_counts;
+
+  // Results of the last count_dispatches call.
+  int dispatch_target; // Class id, -1 for SELF_TYPE.
+  long long self_dispatch_count;
+  long long dispatch_count;
+  long long static_dispatch_count;
+};
+
+#endif
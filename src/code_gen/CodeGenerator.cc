@@ -6,19 +6,63 @@
 #include <fstream>
 #include <algorithm>
 #include <vector>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <system_error>
+#include <memory>
+#include <csignal>
+#include <sys/resource.h>
 #include "ClassTree.h"
 #include "CodeGenerator.h"
+#include "ClassGenerator.h"
 #include "SymbolTable.h"
 #include "NameGenerator.h"
 
 using namespace std;
 
-int spaces_per_tab = 4; // Used to keep track of line length.
+// Set by SIGUSR1 to ask generate_code for a statistics report.
+static volatile sig_atomic_t stats_requested = 0;
+
+// FUNCTION: Handles SIGUSR1.
+static void request_stats(int) {
+  stats_requested = 1;
+}
+
+// FUNCTION: Constructor.
+GenerationStats::GenerationStats()
+    : expansions(NUM_EXPRESSION_TYPES, 0)
+    , depths()
+    , dispatch_lookups(0)
+    , dispatch_candidates(0)
+    , max_dispatch_candidates(0)
+    , max_identifiers(0)
+    , max_scopes(0) {}
+
+// FUNCTION: Adds the counts of @other to these.
+void GenerationStats::add(const GenerationStats& other) {
+  for (int i = 0; i < NUM_EXPRESSION_TYPES; i++) {
+    expansions[i] += other.expansions[i];
+  }
+  if (depths.size() < other.depths.size()) depths.resize(other.depths.size(), 0);
+  for (int i = 0; i < other.depths.size(); i++) {
+    depths[i] += other.depths[i];
+  }
+  dispatch_lookups += other.dispatch_lookups;
+  dispatch_candidates += other.dispatch_candidates;
+  max_dispatch_candidates = max(max_dispatch_candidates, other.max_dispatch_candidates);
+  max_identifiers = max(max_identifiers, other.max_identifiers);
+  max_scopes = max(max_scopes, other.max_scopes);
+}
 
 // FUNCTION: Constructor.
-CodeGenerator::CodeGenerator(int num_classes, string word_corpus)
-    : output_file("output.cl")
-    , writer(output_file)
+CodeGenerator::CodeGenerator(int num_classes, string word_corpus, int num_threads, uint64_t seed,
+                             string output_path, bool map_output, string stats_path,
+                             string trace_path, bool trace_expressions,
+                             int max_recursion_depth, int max_expression_count)
+    : output_file(output_path)
     , class_name_length(10)
     , class_attribute_length(5)
     , class_method_length(5)
@@ -30,443 +74,452 @@ CodeGenerator::CodeGenerator(int num_classes, string word_corpus)
     , num_methods_per_class(3)
     , max_num_method_args(5)
     , probability_repeat_method_name(0.2)
+    , random(seed)
     , tree(name_generator, num_classes, num_attributes_per_class, num_methods_per_class,
-      max_num_method_args, probability_repeat_method_name) {
+      max_num_method_args, probability_repeat_method_name, random.derive(0))
+    , trace_expressions(trace_expressions)
+    , main_trace(0) {
 
   // Internal configuration.
-  this->max_recursion_depth = 5;
+  this->max_recursion_depth = max_recursion_depth;
   this->probability_initialized = 0.75;
   this->max_block_length = 5;
   this->max_let_defines = 4;
   this->max_case_branches = 7;
   this->max_line_length = 80;
-  this->current_line_length = 0;
-  this->max_expression_count = 1000000000; // 1 billion.
+  this->max_expression_count = max_expression_count; // 1 billion by default.
+  this->num_threads = num_threads < 1 ? 1 : num_threads;
+  this->progress = (output_file == "-") ? &cerr : &cout;
 
-  // Initialization of internal state.
-  this->indentation_tabs = 0;
-  this->recursive_depth = 0;
-  this->expression_count = 0;
-  this->identifiers = SymbolTable();
-
-  // Initialize the class tree.
-  tree.generate_class_information();
-
-  // Create map from expansion name -> expansion weight.
-  vector<float> expression_weights = vector<float>(NUM_EXPRESSION_TYPES, 1.0);
-  this->expression_map = map<ExpansionType, float>();
-  for (int i = ExpansionType::New; i < NUM_EXPRESSION_TYPES; i++) {
-    this->expression_map[static_cast<ExpansionType>(i)] = expression_weights[i];
-  }
-}
-
-// FUNCTION: Generates an expansion of the given name. This
-//  is different from generate_expression in the sense that the input
-//  to this function is a type of expression expansion. For
-//  example, "dispatch" is a type of expansion, and it may
-//  evaluate to an expression of type "Int".
-void CodeGenerator::generate_expansion(ExpansionType expansion, string expression_type) {
-  if (expansion == New) {
-    generate_new(expression_type);
-  } else if (expansion == Bool) {
-    generate_bool();
-  } else if (expansion == String) {
-    generate_string();
-  } else if (expansion == Int) {
-    generate_int();
-  } else if (expansion == Identifier) {
-    generate_identifier(expression_type, false);
-  } else if (expansion == Assignment) {
-    generate_assignment(expression_type, false);
-  } else if (expansion == SelfDispatch) {
-    write_dispatch("self");
-  } else if (expansion == StaticDispatch) {
-    write_dispatch("static");
-  } else if (expansion == Dispatch) {
-    write_dispatch("regular");
-  } else if (expansion == Conditional) {
-    generate_conditional(expression_type);
-  } else if (expansion == Loop) {
-    generate_loop();
-  } else if (expansion == Block) {
-    generate_block(expression_type);
-  } else if (expansion == IsVoid) {
-    generate_isvoid();
-  } else if (expansion == Arithmetic) {
-    generate_arithmetic();
-  } else if (expansion == Comparison) {
-    generate_comparison();
-  } else if (expansion == IntComplement) {
-    generate_int_complement();
-  } else if (expansion == BoolComplement) {
-    generate_bool_complement();
-  } else if (expansion == Let) {
-    generate_let(expression_type);
-  } else if (expansion == Case) {
-    generate_case(expression_type);
+  // Choose the output backend. stdout can't be mapped.
+  if (map_output && output_file != "-") {
+    this->writer = unique_ptr<OutputWriter>(new MappedOutputWriter(output_file));
   } else {
-    throw "Internal error: chosen expression type not a possible expansion.";
+    this->writer = unique_ptr<OutputWriter>(new OutputWriter(output_file));
   }
-}
 
-// FUNCTION: This is a fairly tricky function. We describe
-//  the parameters separately and in detail below:
-//
-//  [String] possible_expansions:
-//          This should be passed in as an empty vector and
-//          passed by reference. At the end, it will be filled
-//          with the names of possible valid expansions, given
-//          the fact that the resulting expression must satisfy
-//          expression_type, and also stay within the recursion
-//          depth limit and max number of expressions.
-//  [Float] probability_cutoffs:
-//          This should be passed in as an empty vector and
-//          passed by reference. As we populate the possible_expansions
-//          vector, we will also populate probability cutoffs
-//          with the float weights that are pulled from expression_map
-//          (this is configured when the class is created and denotes
-//          the amount of weight each expansion should have -- for
-//          instance, if you set "new" to zero then you will get no
-//          "new" expansions).
-//  String expression_type:
-//          A string representing the class we are trying to generate. This
-//          means that for the expansion to be valid, there must be an expansion
-//          of the given type that will generate a static type <= expression_type.
-//
-//  Returns:
-//       We return the sum of the entries in probability cutoffs. This can be used
-//       for normalization after.
-//
-//  Example:
-//        Suppose there are four expansion types: ["new", "constant", "assign", "dispatch"].
-//        The user has configured the corresponding weights: [1.5, 0.5, 1.2, 12.3].
-//        It turns out, that only the first three are valid if we are trying to generate
-//        an "Int" (that is, we cannot generate an expression <= Int using a dispatch). Then,
-//        we might end up with:
-//
-//        possible_expansions = ["new", "assign", "constant"]
-//        probability_cutoffs = [1.5, 1.2, 0.5]
-//        return value        = 3.2
-float CodeGenerator::populate_possible_expansions(vector<ExpansionType>& possible_expansions,
-      vector<float>& probability_cutoffs, string expression_type) {
-
-  // New.
-  float normalization_factor = expression_map[New];
-  possible_expansions.push_back(New);
-  probability_cutoffs.push_back(expression_map[New]);
-
-  // Bool constants.
-  if (tree.is_child_of("Bool", expression_type)) {
-    normalization_factor += expression_map[Bool];
-    possible_expansions.push_back(Bool);
-    probability_cutoffs.push_back(expression_map[Bool]);
-  }
-
-  // String constants.
-  if (tree.is_child_of("String", expression_type)) {
-    normalization_factor += expression_map[String];
-    possible_expansions.push_back(String);
-    probability_cutoffs.push_back(expression_map[String]);
+  // Statistics.
+  this->stats_file = stats_path;
+  this->classes_done = 0;
+  this->classes_total = 0;
+  this->generation_seconds = 0;
+  this->writing_seconds = 0;
+  if (stats_file != "" && stats_file != "-") {
+    this->stats_output = unique_ptr<ostream>(new ofstream(stats_file.c_str()));
+    if (!*stats_output) throw "Could not open statistics file " + stats_file + ".";
   }
 
-  // Int constants.
-  if (tree.is_child_of("Int", expression_type)) {
-    normalization_factor += expression_map[Int];
-    possible_expansions.push_back(Int);
-    probability_cutoffs.push_back(expression_map[Int]);
+  // Tracing.
+  if (trace_path != "") {
+    this->trace_writer = unique_ptr<TraceWriter>(new TraceWriter(trace_path));
+    trace_writer->name_thread(0, "main");
   }
 
-  // Identifiers.
-  if (generate_identifier(expression_type, true)) {
-    normalization_factor += expression_map[Identifier];
-    possible_expansions.push_back(Identifier);
-    probability_cutoffs.push_back(expression_map[Identifier]);
-  }
-
-  // Assignment.
-  if (generate_assignment(expression_type, true) && recursive_depth < max_recursion_depth
-                                                  && expression_count < max_expression_count) {
-    normalization_factor += expression_map[Assignment];
-    possible_expansions.push_back(Assignment);
-    probability_cutoffs.push_back(expression_map[Assignment]);
+  // Initialize the class tree.
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  tree.generate_class_information(trace_writer ? &main_trace : NULL);
+  this->tree_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  start = chrono::steady_clock::now();
+  if (trace_writer) main_trace.begin("tables", "build_tables");
+
+  // Bucket identifiers by declared type: one bucket per class in
+  // preorder, spanning its subtree, and a final one for SELF_TYPE.
+  this->identifier_bucket_types = vector<string>();
+  this->identifier_bucket_ends = vector<int>();
+  for (int i = 0; i < tree.preorder_classes.size(); i++) {
+    identifier_bucket_types.push_back(tree.class_names[tree.preorder_classes[i]]);
+    identifier_bucket_ends.push_back(i + tree.class_subtree_size[tree.preorder_classes[i]]);
   }
-
-  // Dispatch.
-  generate_dispatch_structures(expression_type);
-  if (recursive_depth < max_recursion_depth && expression_count < max_expression_count) {
-    if (self_dispatches.size() != 0) {
-      normalization_factor += expression_map[SelfDispatch];
-      possible_expansions.push_back(SelfDispatch);
-      probability_cutoffs.push_back(expression_map[SelfDispatch]);
-    }
-    if (static_dispatches.size() != 0) {
-      normalization_factor += expression_map[StaticDispatch];
-      possible_expansions.push_back(StaticDispatch);
-      probability_cutoffs.push_back(expression_map[StaticDispatch]);
-    }
-    if (dispatches.size() != 0) {
-      normalization_factor += expression_map[Dispatch];
-      possible_expansions.push_back(Dispatch);
-      probability_cutoffs.push_back(expression_map[Dispatch]);
+  this->self_type_bucket = identifier_bucket_types.size();
+  identifier_bucket_types.push_back("SELF_TYPE");
+  identifier_bucket_ends.push_back(self_type_bucket + 1);
+
+  // Group the methods in the tree's method table by return type.
+  int num_total_classes = tree.class_names.size();
+  this->methods_returning = vector<vector<int> >(num_total_classes);
+  this->self_type_methods = vector<vector<int> >(num_total_classes);
+  for (int i = 0; i < tree.method_names.size(); i++) {
+    int return_type = tree.method_return_types[i];
+    if (return_type == -1) {
+      self_type_methods[tree.method_classes[i]].push_back(i);
+    } else {
+      methods_returning[return_type].push_back(i);
     }
   }
 
-  // Conditional.
-  if (recursive_depth < max_recursion_depth && expression_count < max_expression_count) {
-    normalization_factor += expression_map[Conditional];
-    possible_expansions.push_back(Conditional);
-    probability_cutoffs.push_back(expression_map[Conditional]);
-  }
-
-  // Loop.
-  if (expression_type == "Object" && recursive_depth < max_recursion_depth
-                                    && expression_count < max_expression_count) {
-    normalization_factor += expression_map[Loop];
-    possible_expansions.push_back(Loop);
-    probability_cutoffs.push_back(expression_map[Loop]);
-  }
-
-  // Block.
-  if (recursive_depth < max_recursion_depth && expression_count < max_expression_count) {
-    normalization_factor += expression_map[Block];
-    possible_expansions.push_back(Block);
-    probability_cutoffs.push_back(expression_map[Block]);
-  }
-
-  // isVoid.
-  if (tree.is_child_of("Bool", expression_type) && recursive_depth < max_recursion_depth
-                                            && expression_count < max_expression_count) {
-    normalization_factor += expression_map[IsVoid];
-    possible_expansions.push_back(IsVoid);
-    probability_cutoffs.push_back(expression_map[IsVoid]);
-  }
+  build_dispatch_index();
 
-  // Arithmetic.
-  if (tree.is_child_of("Int", expression_type) && recursive_depth < max_recursion_depth
-                                            && expression_count < max_expression_count) {
-    normalization_factor += expression_map[Arithmetic];
-    possible_expansions.push_back(Arithmetic);
-    probability_cutoffs.push_back(expression_map[Arithmetic]);
+  // Expansion weights, indexed by ExpansionType.
+  this->expression_weights = vector<float>();
+  for (int i = 0; i < NUM_EXPRESSION_TYPES; i++) {
+    expression_weights.push_back(ClassGenerator::expansion_registry[i].weight);
   }
-
-  // Comparison.
-  if (tree.is_child_of("Bool", expression_type) && recursive_depth < max_recursion_depth
-                                            && expression_count < max_expression_count) {
-    normalization_factor += expression_map[Comparison];
-    possible_expansions.push_back(Comparison);
-    probability_cutoffs.push_back(expression_map[Comparison]);
-  }
-
-  // Integer complement.
-  if (tree.is_child_of("Int", expression_type) && recursive_depth < max_recursion_depth
-                                            && expression_count < max_expression_count) {
-    normalization_factor += expression_map[IntComplement];
-    possible_expansions.push_back(IntComplement);
-    probability_cutoffs.push_back(expression_map[IntComplement]);
+  build_expansion_tables();
+  this->tables_seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  if (trace_writer) {
+    main_trace.end();
+    trace_writer->write(main_trace);
   }
-
-  // Boolean complement.
-  if (tree.is_child_of("Bool", expression_type) && recursive_depth < max_recursion_depth
-                                            && expression_count < max_expression_count) {
-    normalization_factor += expression_map[BoolComplement];
-    possible_expansions.push_back(BoolComplement);
-    probability_cutoffs.push_back(expression_map[BoolComplement]);
-  }
-
-  // Let statement.
-  if (recursive_depth < max_recursion_depth && expression_count < max_expression_count) {
-    normalization_factor += expression_map[Let];
-    possible_expansions.push_back(Let);
-    probability_cutoffs.push_back(expression_map[Let]);
-  }
-
-  // Case.
-  if (recursive_depth < max_recursion_depth && expression_count < max_expression_count) {
-    normalization_factor += expression_map[Case];
-    possible_expansions.push_back(Case);
-    probability_cutoffs.push_back(expression_map[Case]);
-  }
-
-  return normalization_factor;
 }
 
-// FUNCTION: Generates an expression of the given type.
-void CodeGenerator::generate_expression(string expression_type) {
-
-  // Increase recursive depth.
-  recursive_depth++;
-
-  // Increase expression count.
-  expression_count++;
-
-  // Compute possible expansions and keep track of weights.
-  vector<ExpansionType> possible_expansions = vector<ExpansionType>();
-  vector<float> probability_cutoffs = vector<float>();
-  float normalization_factor = populate_possible_expansions(possible_expansions,
-                                                            probability_cutoffs,
-                                                            expression_type);
-
-  // Choose expansion.
-  float probability_sum = 0.0;
-  for (int i = 0; i < probability_cutoffs.size(); i++) {
-    probability_sum += probability_cutoffs[i];
-    probability_cutoffs[i] = probability_sum;
-  }
-  transform(probability_cutoffs.begin(), probability_cutoffs.end(), probability_cutoffs.begin(),
-                                 [normalization_factor](float i){return i / normalization_factor;});
-  double probability_cutoff = ((double) rand() / (RAND_MAX));
-  int expansion_index = 0;
-  for (; expansion_index < probability_cutoffs.size(); expansion_index++) {
-    if (probability_cutoff < probability_cutoffs[expansion_index]) break;
-  }
-  ExpansionType expansion = possible_expansions[expansion_index];
-
-  // Generate code corresponding to chosen expansion.
-  generate_expansion(expansion, expression_type);
-
-  // Reduce recursive depth.
-  recursive_depth--;
-}
-
-// FUNCTION: Prints the number of tabs indicated by global indentation_tabs.
-// NOTES: - This should only be used on a new line. Otherwise, current_line_length
-//          will be incorrect.
-void CodeGenerator::print_tabs() {
-  current_line_length = indentation_tabs * spaces_per_tab;
-  writer << string(indentation_tabs, '\t');
-}
-
-// FUNCTION: Prints one attribute.
-void CodeGenerator::print_attribute(string class_name, string attribute_name, string attribute_type) {
-  print_tabs();
-  indentation_tabs++;
-
-  writer << attribute_name << ": " << attribute_type;
-  current_line_length += attribute_name.length() + attribute_type.length() + 2;
-
-  // Generate initialization based on initialization probability.
-  double cutoff = ((double) rand() / (RAND_MAX));
-  if (cutoff >= probability_initialized) {
-    writer << ";" << endl;
-  } else {
-    writer << " <- (";
-    current_line_length += 5;
-    generate_expression(attribute_type);
-    writer << ");" << endl;
-  }
-
-  indentation_tabs--;
+// FUNCTION: Appends @method_index to @candidates; object types are the classes below @root.
+static void add_type_dispatch(const ClassTree& tree, TypeDispatches& candidates, int method_index, int root) {
+  long long dispatches = candidates.dispatch_counts.empty() ? 0 : candidates.dispatch_counts.back();
+  long long static_dispatches = candidates.static_dispatch_counts.empty() ?
+                                  0 : candidates.static_dispatch_counts.back();
+  candidates.methods.push_back(method_index);
+  candidates.object_roots.push_back(root);
+  candidates.dispatch_counts.push_back(dispatches + tree.class_subtree_size[root]);
+  candidates.static_dispatch_counts.push_back(static_dispatches + tree.count_nested_pairs(root));
 }
 
-// FUNCTION: Prints one method.
-// NOTES: Handles updating the identifiers vector with
-//        all the arguments in one method.
-void CodeGenerator::print_method(string class_name, string method_name, string method_type) {
-
-  // Update identifiers.
-  identifiers.enter_scope();
-  map<string, vector<pair<string, string> > > class_method_args = tree.class_method_args[class_name];
-  vector<pair<string, string> > method_args = class_method_args[method_name];
-  for (int i = 0; i < method_args.size(); i++) {
-    identifiers.add_id(method_args[i].first, method_args[i].second);
-  }
+// FUNCTION: Builds, for every class, the methods a regular or static
+//           dispatch producing that class can call.
+// NOTES: - Consider A.m() and (A)@B.m() where m is declared in class K.
+//          * If m returns a class C, we need C <= the type, and then any
+//            A <= B <= K works, so the object types are the classes below K.
+//          * If m returns SELF_TYPE, we need A <= B <= K and B <= the type,
+//            so K and the type must be comparable and the object types are
+//            the classes below the lower of the two.
+//        - Built once here and shared read-only by every ClassGenerator,
+//          rather than each worker filling in its own copy.
+void CodeGenerator::build_dispatch_index() {
+  int num_total_classes = tree.class_names.size();
+  this->type_dispatch_index = vector<TypeDispatches>(num_total_classes);
+  for (int type_id = 0; type_id < num_total_classes; type_id++) {
+    TypeDispatches& candidates = type_dispatch_index[type_id];
+    int first = tree.class_preorder[type_id];
+    int last = first + tree.class_subtree_size[type_id];
+
+    // Methods returning a class below the type.
+    for (int i = first; i < last; i++) {
+      const vector<int>& methods = methods_returning[tree.preorder_classes[i]];
+      for (int j = 0; j < methods.size(); j++) {
+        add_type_dispatch(tree, candidates, methods[j], tree.method_classes[methods[j]]);
+      }
+    }
 
-  // Tabs + method name.
-  print_tabs();
-  writer << method_name << "(";
+    // Methods returning SELF_TYPE declared above the type...
+    for (int ancestor = tree.class_parent[type_id]; ancestor != -1; ancestor = tree.class_parent[ancestor]) {
+      const vector<int>& methods = self_type_methods[ancestor];
+      for (int j = 0; j < methods.size(); j++) {
+        add_type_dispatch(tree, candidates, methods[j], type_id);
+      }
+    }
 
-  // Print arguments.
-  vector<pair<string, string> > args = tree.class_method_args[class_name][method_name];
-  for (int i = 0; i < args.size(); i++) {
-    if (i == args.size() - 1) {
-      writer << args[i].first << ": " << args[i].second;
-    } else {
-      writer << args[i].first << ": " << args[i].second << ", ";
+    // ... or at/below it.
+    for (int i = first; i < last; i++) {
+      int class_id = tree.preorder_classes[i];
+      const vector<int>& methods = self_type_methods[class_id];
+      for (int j = 0; j < methods.size(); j++) {
+        add_type_dispatch(tree, candidates, methods[j], class_id);
+      }
     }
   }
-
-  // Print return type.
-  writer << ") : " << method_type << " {" << endl;
-  indentation_tabs++;
-
-  // Generate body.
-  print_tabs();
-  generate_expression(method_type);
-  writer << endl;
-
-  // End method declaration.
-  indentation_tabs--;
-  print_tabs();
-  writer << "};" << endl;
-
-  // Remove arguments from identifiers.
-  identifiers.exit_scope();
 }
 
-// FUNCTION: Prints one class.
-// NOTES: - updates identifiers vectors with attributes + self.
-//        - updates current_class as well.
-void CodeGenerator::print_class(string class_name) {
-
-  current_class = class_name;
-
-  // Update identifiers vector with local variables.
-  vector<string> attribute_holders = tree.class_ancestors[class_name];
-  attribute_holders.push_back(class_name);
-  for (int i = 0; i < attribute_holders.size(); i++) {
-    vector<pair<string, string> > current_attribute_pairs = tree.class_attributes[attribute_holders[i]];
-    for (int j = 0; j < current_attribute_pairs.size(); j++) {
-      identifiers.add_id(current_attribute_pairs[j].first, current_attribute_pairs[j].second);
+// FUNCTION: Builds an alias table for every expansion signature.
+//  A signature is (type category * NUM_FEASIBILITY_MASKS + feasibility bits).
+//  The expansions that can produce an expression only depend on:
+//
+//  - The category of the expression type. For example, constants
+//    and arithmetic only produce Int, which conforms to Int and Object.
+//  - Whether there is recursion depth and expression count left
+//    (WITHIN_BUDGET). Everything but constants, new and identifiers
+//    generates subexpressions.
+//  - Whether a matching identifier, assignment and each kind of
+//    dispatch exists (the remaining FEASIBLE_* bits).
+//
+//  Each expansion's descriptor in ClassGenerator::expansion_registry
+//  gives the categories it produces and the bits it requires, so an
+//  expansion is feasible for a signature when its category bit is set
+//  and none of its required bits is missing from the mask. For each
+//  signature we list the feasible expansions and build an alias table
+//  over their configured weights, so generate_expression draws an
+//  expansion in O(1) with the same distribution as normalizing the
+//  weights of the feasible expansions.
+//
+//  Example:
+//        Suppose there are four expansion types: ["new", "constant", "assign", "dispatch"].
+//        The user has configured the corresponding weights: [1.5, 0.5, 1.2, 12.3].
+//        It turns out, that only the first three are valid if we are trying to generate
+//        an "Int" (that is, we cannot generate an expression <= Int using a dispatch). Then
+//        the table for that signature draws "new", "constant" and "assign" with
+//        probabilities 1.5/3.2, 0.5/3.2 and 1.2/3.2.
+//
+// NOTES: - Also records, per category, the feasibility bits required by
+//          expansions with positive weight. Bits nobody needs never change
+//          the table drawn from, so expansion_signature skips their checks.
+void CodeGenerator::build_expansion_tables() {
+  const ExpansionDescriptor* registry = ClassGenerator::expansion_registry;
+  for (int i = 0; i < NUM_EXPRESSION_TYPES; i++) {
+    if (registry[i].expansion != i) {
+      throw "Internal error: expansion registry out of order.";
     }
   }
-  identifiers.add_id("self", class_name);
 
-  // Print class declaration line.
-  string parent = tree.class_ancestors[class_name][0];
-  print_tabs();
-  if (parent == "Object") {
-    writer << "class " << class_name << " {" << endl;
-  } else {
-    writer << "class " << class_name << " inherits " << parent << " {" << endl;
-  }
-  indentation_tabs++;
+  expansion_sets = vector<vector<ExpansionType> >();
+  expansion_tables = vector<AliasTable>();
+  expansion_checks = vector<int>(NUM_TYPE_CATEGORIES, 0);
 
-  // Print attributes.
-  for (int i = 0; i < tree.class_attributes[class_name].size(); i++) {
-    string attribute_name = tree.class_attributes[class_name][i].first;
-    string attribute_type = tree.class_attributes[class_name][i].second;
-    print_attribute(class_name, attribute_name, attribute_type);
-  }
-
-  // One line between methods and attributes.
-  writer << endl;
+  for (int category = 0; category < NUM_TYPE_CATEGORIES; category++) {
+    for (int i = 0; i < NUM_EXPRESSION_TYPES; i++) {
+      if ((registry[i].categories & CATEGORY(category)) && expression_weights[i] > 0) {
+        expansion_checks[category] |= registry[i].requires;
+      }
+    }
 
-  // Print methods.
-  for (int i = 0; i < tree.class_method_names[class_name].size(); i++) {
-    string method_name = tree.class_method_names[class_name][i];
-    string method_type = tree.class_method_types[class_name][method_name];
-    print_method(class_name, method_name, method_type);
+    for (int mask = 0; mask < NUM_FEASIBILITY_MASKS; mask++) {
+      vector<ExpansionType> expansions = vector<ExpansionType>();
+      vector<float> weights = vector<float>();
+      for (int i = 0; i < NUM_EXPRESSION_TYPES; i++) {
+        if (!(registry[i].categories & CATEGORY(category))) continue;
+        if (registry[i].requires & ~mask) continue;
+        expansions.push_back(static_cast<ExpansionType>(i));
+        weights.push_back(expression_weights[i]);
+      }
+      expansion_sets.push_back(expansions);
+      expansion_tables.push_back(AliasTable(weights));
+    }
   }
-
-  // Print class end.
-  indentation_tabs--;
-  print_tabs();
-  writer << "};" << endl << endl;
-
-  // Reset identifiers vector.
-  identifiers.exit_scope();
 }
 
 // FUNCTION: Main function that generates the output code file.
+// NOTES: - Every class gets its own random stream and is generated
+//          into its own buffer by one of num_threads workers.
+//          This thread writes the buffers out in class order, so the
+//          output is the same for any number of threads.
+//        - Workers stay at most a few classes per thread ahead of the
+//          writer, which bounds the memory held in finished buffers.
+//        - The first error thrown by a worker stops the others and is
+//          rethrown here.
 void CodeGenerator::generate_code() {
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+  TraceBuffer run_trace = TraceBuffer(0);  // Stays open until the end.
+  if (trace_writer) run_trace.begin("generate_code", "generate_code");
 
+  // Classes to generate, in output order.
+  vector<int> class_indices = vector<int>();
   for (int i = 0; i < tree.class_names.size(); i++) {
     string class_name = tree.class_names[i];
     if (class_name == "Object" || class_name == "Bool" ||
         class_name == "String" || class_name == "Int" ||
         class_name == "IO") continue;
-    print_class(tree.class_names[i]);
+    class_indices.push_back(i);
+  }
+  int num_jobs = class_indices.size();
+  int window = 4 * num_threads;
+  classes_total = num_jobs;
+
+  // State shared with the workers, guarded by lock.
+  mutex lock;
+  condition_variable job_finished;
+  condition_variable slot_freed;
+  vector<string> outputs = vector<string>(num_jobs);
+  vector<TraceBuffer> traces = vector<TraceBuffer>(trace_writer ? num_jobs : 0);
+  vector<bool> finished = vector<bool>(num_jobs, false);
+  GenerationStats finished_stats = GenerationStats();  // Not yet in stats.
+  int num_finished = 0;
+  int next_job = 0;
+  int next_write = 0;
+  exception_ptr error = nullptr;
+  chrono::steady_clock::time_point generation_start = chrono::steady_clock::now();
+  chrono::steady_clock::time_point generation_end = generation_start;  // Last body done.
+
+  auto work = [&](int worker) {
+    unique_ptr<ClassGenerator> generator;
+    try {
+      generator = unique_ptr<ClassGenerator>(new ClassGenerator(*this, worker));
+    } catch (...) {
+      unique_lock<mutex> guard(lock);
+      if (error == nullptr) error = current_exception();
+      job_finished.notify_all();
+      slot_freed.notify_all();
+      return;
+    }
+    while (true) {
+      int job;
+      {
+        unique_lock<mutex> guard(lock);
+        slot_freed.wait(guard, [&]() {
+          return error != nullptr || next_job == num_jobs || next_job < next_write + window;
+        });
+        if (error != nullptr || next_job == num_jobs) return;
+        job = next_job++;
+      }
+
+      string output;
+      try {
+        int i = class_indices[job];
+        generator->generate_class(tree.class_names[i], random.derive(i + 1));
+        output = string(generator->output().data(), generator->output().size());
+      } catch (...) {
+        unique_lock<mutex> guard(lock);
+        if (error == nullptr) error = current_exception();
+        job_finished.notify_all();
+        slot_freed.notify_all();
+        return;
+      }
+
+      unique_lock<mutex> guard(lock);
+      outputs[job].swap(output);
+      if (trace_writer) {
+        traces[job].set_thread(worker);
+        traces[job].swap(generator->trace_spans());
+      }
+      finished[job] = true;
+      finished_stats.add(generator->statistics());
+      num_finished++;
+      if (num_finished == num_jobs) generation_end = chrono::steady_clock::now();
+      job_finished.notify_all();
+    }
+  };
+
+  // Report statistics on SIGUSR1 while the classes are written.
+  void (*previous_handler)(int) = SIG_DFL;
+  if (stats_file != "") previous_handler = signal(SIGUSR1, request_stats);
+
+  // Start the workers, no more than there are classes. If one can't be
+  // started, the error stops the others and the writer below.
+  int num_workers = min(num_threads, max(num_jobs, 1));
+  vector<thread> workers = vector<thread>();
+  try {
+    for (int i = 0; i < num_workers; i++) {
+      if (trace_writer) trace_writer->name_thread(i + 1, "worker " + to_string(i + 1));
+      workers.push_back(thread(work, i + 1));
+    }
+  } catch (const system_error& e) {
+    unique_lock<mutex> guard(lock);
+    if (error == nullptr) {
+      error = make_exception_ptr("Could not start worker thread " + to_string(workers.size() + 1) +
+                                 ": " + e.what() + ".");
+    }
+    slot_freed.notify_all();
+  } catch (...) {
+    unique_lock<mutex> guard(lock);
+    if (error == nullptr) error = current_exception();
+    slot_freed.notify_all();
+  }
 
-    if (i % 10 == 0 && i > 0) cout << i << " classes generated." << endl;
+  // Write classes out in order as they finish.
+  try {
+    for (int job = 0; job < num_jobs; job++) {
+      string output;
+      TraceBuffer class_trace = TraceBuffer();
+      {
+        unique_lock<mutex> guard(lock);
+        job_finished.wait(guard, [&]() { return error != nullptr || finished[job]; });
+        if (error != nullptr) break;
+        output.swap(outputs[job]);
+        if (trace_writer) {
+          class_trace.set_thread(traces[job].thread());
+          class_trace.swap(traces[job]);
+        }
+        next_write = job + 1;
+        stats.add(finished_stats);
+        finished_stats = GenerationStats();
+        classes_done = num_finished;
+      }
+      slot_freed.notify_all();
+      chrono::steady_clock::time_point write_start = chrono::steady_clock::now();
+      int i = class_indices[job];
+      if (trace_writer) main_trace.begin("output", tree.class_names[i]);
+      writer->append(output.data(), output.size());
+      if (trace_writer) {
+        main_trace.end("\"bytes\": " + to_string(output.size()));
+        trace_writer->write(class_trace);
+        trace_writer->write(main_trace);
+      }
+      writing_seconds += chrono::duration<double>(chrono::steady_clock::now() - write_start).count();
+
+      if (stats_requested) {
+        stats_requested = 0;
+        generation_seconds = chrono::duration<double>(chrono::steady_clock::now() - generation_start).count();
+        report_stats(false);
+      }
+
+      if (i % 10 == 0 && i > 0) *progress << i << " classes generated." << endl;
+    }
+  } catch (...) {
+    unique_lock<mutex> guard(lock);
+    if (error == nullptr) error = current_exception();
+    slot_freed.notify_all();
+  }
+  for (int i = 0; i < workers.size(); i++) {
+    workers[i].join();
+  }
+  if (stats_file != "") signal(SIGUSR1, previous_handler);
+  if (error != nullptr) rethrow_exception(error);
+  chrono::steady_clock::time_point write_start = chrono::steady_clock::now();
+  if (trace_writer) main_trace.begin("output", "close");
+  writer->close();
+  if (trace_writer) main_trace.end();
+  writing_seconds += chrono::duration<double>(chrono::steady_clock::now() - write_start).count();
+  stats.add(finished_stats);
+  classes_done = num_finished;
+
+  // Report output throughput.
+  double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  double megabytes = writer->bytes_written() / 1e6;
+  string destination = (output_file == "-") ? "stdout" : output_file;
+  *progress << "Wrote " << megabytes << " MB to " << destination << " in " << seconds
+       << " s (" << (seconds > 0 ? megabytes / seconds : 0) << " MB/s)." << endl;
+
+  generation_seconds = chrono::duration<double>(generation_end - generation_start).count();
+  report_stats(true);
+
+  if (trace_writer) {
+    run_trace.end("\"classes\": " + to_string(num_jobs) + ", \"threads\": " + to_string(num_workers));
+    trace_writer->write(main_trace);
+    trace_writer->write(run_trace);
+    trace_writer->close();
+  }
+}
+
+// FUNCTION: Writes the statistics to the stats file, if there is one.
+void CodeGenerator::report_stats(bool final) {
+  if (stats_file == "") return;
+  ostream& out = (stats_file == "-") ? *progress : *stats_output;
+  write_stats(out, final);
+  out.flush();
+  if (!out) throw "Could not write statistics to " + stats_file + ".";
+}
+
+// FUNCTION: Writes the statistics gathered so far as one line of JSON.
+// NOTES: - Counts cover the classes generated so far (all of them once
+//          the run is over). They don't depend on the number of threads.
+//        - Names rejected counts retries in NameGenerator::generate,
+//          for the class tree and for let and case variables.
+void CodeGenerator::write_stats(ostream& out, bool final) {
+  long long total_expressions = 0;
+  for (int i = 0; i < NUM_EXPRESSION_TYPES; i++) {
+    total_expressions += stats.expansions[i];
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+
+  out << "{\"final\": " << (final ? "true" : "false")
+      << ", \"classes\": {\"total\": " << classes_total
+      << ", \"generated\": " << classes_done << "}"
+      << ", \"seconds\": {\"class_tree\": " << tree_seconds
+      << ", \"tables\": " << tables_seconds
+      << ", \"generation\": " << generation_seconds
+      << ", \"writing\": " << writing_seconds << "}"
+      << ", \"expressions\": " << total_expressions
+      << ", \"expansions\": {";
+  for (int i = 0; i < NUM_EXPRESSION_TYPES; i++) {
+    out << (i == 0 ? "" : ", ") << '"' << ClassGenerator::expansion_registry[i].name << "\": " << stats.expansions[i];
+  }
+  out << "}, \"depths\": [";
+  for (int i = 0; i < stats.depths.size(); i++) {
+    out << (i == 0 ? "" : ", ") << stats.depths[i];
   }
+  out << "], \"dispatch_candidates\": {\"lookups\": " << stats.dispatch_lookups
+      << ", \"total\": " << stats.dispatch_candidates
+      << ", \"max\": " << stats.max_dispatch_candidates << "}"
+      << ", \"symbol_table\": {\"max_ids\": " << stats.max_identifiers
+      << ", \"max_scopes\": " << stats.max_scopes << "}"
+      << ", \"names_rejected\": " << name_generator.names_rejected()
+      << ", \"bytes_written\": " << writer->bytes_written()
+      << ", \"peak_rss_kb\": " << usage.ru_maxrss << "}" << endl;
 }
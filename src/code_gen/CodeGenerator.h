@@ -5,14 +5,41 @@
 #define CODEGENERATOR_H_
 
 #include "ClassTree.h"
-#include <fstream>
 #include <vector>
+#include <ostream>
+#include <memory>
 #include "SymbolTable.h"
 #include "NameGenerator.h"
+#include "AliasTable.h"
+#include "OutputWriter.h"
+#include "Random.h"
+#include "Trace.h"
 
 // Total number of expression types in COOL.
 #define NUM_EXPRESSION_TYPES 19
 
+// Bits describing which expansions are feasible for an expression,
+// apart from those fixed by its type category. Together with the
+// category they form the signature used to pick an alias table.
+#define FEASIBLE_IDENTIFIER       1
+#define FEASIBLE_ASSIGNMENT       2
+#define FEASIBLE_SELF_DISPATCH    4
+#define FEASIBLE_STATIC_DISPATCH  8
+#define FEASIBLE_DISPATCH         16
+#define WITHIN_BUDGET             32  // Recursion depth and expression count left.
+#define NUM_FEASIBILITY_MASKS     64
+
+// ENUM TypeCategory
+// -----------------
+// The kinds of expression types that differ in which
+// expansions can produce them.
+enum TypeCategory {BoolType, IntType, StringType, ObjectType, SelfType, OtherType,
+  NUM_TYPE_CATEGORIES};
+
+// Sets of type categories, as bits.
+#define CATEGORY(category) (1 << (category))
+#define ANY_CATEGORY       ((1 << NUM_TYPE_CATEGORIES) - 1)
+
 // ENUM ExpressionType
 // -------------------
 // Enumerates all the possible expression types we can generate.
@@ -20,6 +47,46 @@ enum ExpansionType {New, Bool, String, Int, Identifier, Assignment, Dispatch,
   StaticDispatch, SelfDispatch, Conditional, Loop, Block, IsVoid, Arithmetic,
   Comparison, IntComplement, BoolComplement, Let, Case};
 
+// STRUCT TypeDispatches
+// ---------------------
+// The methods that a regular or static dispatch producing one
+// class type can call. For the i-th method, the object types
+// that work are exactly the classes below object_roots[i]
+// (static types lie between the object type and that root).
+// Counts are cumulative so a candidate can be drawn with a
+// binary search instead of listing every candidate.
+struct TypeDispatches {
+  std::vector<int> methods;
+  std::vector<int> object_roots;
+  std::vector<long long> dispatch_counts;
+  std::vector<long long> static_dispatch_counts;
+};
+
+// STRUCT GenerationStats
+// -----------------------
+// Counters kept while class bodies are generated. A ClassGenerator
+// fills one in for each class and the CodeGenerator adds them up.
+//    expansions           : ExpansionType -> expressions generated with it
+//    depths               : recursion depth (0 outermost) -> expressions generated at it
+//    dispatch_lookups     : dispatch candidate lists looked up (one per
+//                           expression of a class type within budget)
+//    dispatch_candidates  : methods in those lists, in total
+//    max_dispatch_candidates: methods in the longest one
+//    max_identifiers      : most definitions in the symbol table at once
+//    max_scopes           : most nested scopes in the symbol table at once
+struct GenerationStats {
+  std::vector<long long> expansions;
+  std::vector<long long> depths;
+  long long dispatch_lookups;
+  long long dispatch_candidates;
+  long long max_dispatch_candidates;
+  long long max_identifiers;
+  long long max_scopes;
+
+  GenerationStats();
+  void add(const GenerationStats& other);
+};
+
 // CLASS CodeGenerator
 // -------------------
 // This is the standalone class that generates
@@ -34,6 +101,23 @@ enum ExpansionType {New, Bool, String, Int, Identifier, Assignment, Dispatch,
 // some real configuration *power* -- go edit
 // the constants in the constructor. Much of
 // the configuration is currently hardcoded there.
+//
+// NOTES: - The class tree and everything derived from it are
+//          built here once and are read-only afterwards. The
+//          bodies of the classes are generated by ClassGenerator
+//          instances (one per thread), each class with its own
+//          random stream, so the output only depends on the seed
+//          and not on the number of threads.
+//        - Random streams derived from the seed: stream 0 builds the
+//          class tree and stream i + 1 generates tree.class_names[i].
+//        - With a stats path, generation statistics are written there as
+//          one line of JSON at the end of the run, and also whenever the
+//          process gets SIGUSR1 while classes are being written.
+//        - With a trace path, a Chrome trace-event timeline is written
+//          there: the class tree phases and tables on thread 0, each
+//          class and method on the worker (1 to num_threads) that
+//          generated it, and the writing of each class on thread 0.
+//          Spans are written as classes are, so memory stays bounded.
 class CodeGenerator {
 public:
 
@@ -45,57 +129,80 @@ public:
   //    String corpus_name
   //        The path (relative or absolute) to the corpus from
   //        which to draw names.
-  CodeGenerator (int num_classes = 10, std::string corpus_name = "");
+  //    Int num_threads
+  //        The number of threads generating class bodies.
+  //    Unsigned seed
+  //        The seed that every random decision is derived from.
+  //    String output_path
+  //        The file to write the program to, or "-" for stdout
+  //        (progress then goes to stderr).
+  //    Bool map_output
+  //        Whether to write the file through a memory mapping
+  //        instead of write calls. Ignored for stdout.
+  //    String stats_path
+  //        The file to write statistics to, "-" for the progress
+  //        stream, or "" for no statistics.
+  //    String trace_path
+  //        The file to write a trace to, or "" for no trace.
+  //    Bool trace_expressions
+  //        Whether the trace also has a span for each attribute
+  //        initializer and method body.
+  //    Int max_recursion_depth
+  //        How deep expressions can nest. Any depth works: expressions
+  //        are generated from a heap stack, not by recursion.
+  //    Int max_expression_count
+  //        How many expressions a class can have before every further
+  //        one is a leaf. Deep nesting needs this to stay finite.
+  CodeGenerator (int num_classes = 10, std::string corpus_name = "", int num_threads = 1,
+                 uint64_t seed = 0, std::string output_path = "output.cl",
+                 bool map_output = false, std::string stats_path = "",
+                 std::string trace_path = "", bool trace_expressions = false,
+                 int max_recursion_depth = 5, int max_expression_count = 1000000000);
 
   // FUNCTION generate_code
   // ----------------------
-  // Generates code and deposits in the file output.cl.
+  // Generates code and deposits it at the output path.
   void generate_code();
 
+  // FUNCTION write_stats
+  // ---------------------
+  // Writes the statistics gathered so far to @out as one line
+  // of JSON. @final tells whether the run is over.
+  void write_stats(std::ostream& out, bool final);
+
+  // FUNCTION class_tree
+  // -------------------
+  // Returns the class tree the code is generated from.
+  const ClassTree& class_tree() const { return tree; }
+
+  // FUNCTION class_tree_seconds
+  // ---------------------------
+  // Returns the time spent building the class tree, in seconds.
+  double class_tree_seconds() const { return tree_seconds; }
 
 private:
+  friend class ClassGenerator;
+
+  // Internal functions for the constructor.
+  void build_dispatch_index();
+  void build_expansion_tables();
 
-  // Internal functions for generate_code();
-  void generate_expression(std::string type);
-  void print_class(std::string class_name);
-  void print_attribute(std::string class_name, std::string attribute_name, std::string attribute_type);
-  void print_method(std::string class_name, std::string method_name, std::string method_type);
-  void print_tabs();
-
-  // Expression generation.
-  void generate_expansion(ExpansionType expansion, std::string expression_type);
-  float populate_possible_expansions(std::vector<ExpansionType>& possible_expansions,
-    std::vector<float>& probability_cutoffs, std::string expression_type);
-  void generate_new(std::string type);
-  void generate_bool();
-  void generate_string();
-  void generate_int();
-  bool generate_identifier(std::string type, bool abort_early);
-  bool generate_assignment(std::string type, bool abort_early);
-  void generate_dispatch_structures(std::string type);
-  void write_dispatch(std::string dispatch_type);
-  void generate_conditional(std::string type);
-  void generate_loop();
-  void generate_block(std::string type);
-  void generate_isvoid();
-  void generate_arithmetic();
-  void generate_comparison();
-  void generate_bool_complement();
-  void generate_int_complement();
-  void generate_let(std::string type);
-  void generate_case(std::string type);
+  // Internal functions for generate_code.
+  void report_stats(bool final);
 
   // These values can be configured but
   // are currently constants that are
   // hardcoded inside the constructor.
   std::string output_file;
+  std::ostream* progress;        // Where progress messages go.
   int max_recursion_depth;
   int max_block_length;
   int max_let_defines;
   int max_case_branches;
   int max_line_length;
-  int max_expression_count;
+  int max_expression_count;      // Per class.
   float probability_initialized; // This applies to let statements as well.
+  int num_threads;
 
   // The following is declared in the initialization list ---------
 
@@ -113,24 +220,59 @@ private:
   int num_methods_per_class;
   int max_num_method_args;
   float probability_repeat_method_name;
+  Random random;
   ClassTree tree;
 
   // --------------------------------------------------------------
 
   // Variables used internally.
-  std::ofstream writer;
-  std::map<ExpansionType, float> expression_map;
-  SymbolTable identifiers;
-  std::string current_class;
-  int current_line_length; // Currently only updated for expression generation.
-  int recursive_depth;
-  int expression_count;
-  int indentation_tabs;
-
-  // Internal dispatch structures.
-  std::vector<std::pair<std::string, std::string> > self_dispatches;
-  std::vector<std::pair<std::string, std::pair<std::string, std::string> > > dispatches;
-  std::vector<std::pair<std::pair<std::string, std::string>, std::pair<std::string, std::string> > > static_dispatches;
+  std::unique_ptr<OutputWriter> writer;  // Streamed or mapped.
+  std::vector<float> expression_weights;
+  std::vector<std::vector<ExpansionType> > expansion_sets;  // Indexed by signature.
+  std::vector<AliasTable> expansion_tables;                 // Indexed by signature.
+  std::vector<int> expansion_checks;  // Category -> feasibility bits worth checking.
+
+  // Identifier buckets: one per class in preorder, spanning
+  // its subtree, and a final one for SELF_TYPE.
+  std::vector<std::string> identifier_bucket_types;
+  std::vector<int> identifier_bucket_ends;
+  int self_type_bucket;
+
+  // Statistics.
+  //    stats_file     : where report_stats writes ("" for nowhere)
+  //    stats          : totals over the classes generated so far
+  //    classes_done   : the number of classes in stats
+  //    classes_total  : the number of classes to generate (not the basic ones)
+  //    *_seconds      : time spent building the class tree, building the
+  //                     tables derived from it, generating class bodies
+  //                     (wall clock from starting the workers to the last
+  //                     body, while earlier ones are written alongside)
+  //                     and handing them to the writer
+  std::string stats_file;
+  std::unique_ptr<std::ostream> stats_output;
+  GenerationStats stats;
+  int classes_done;
+  int classes_total;
+  double tree_seconds;
+  double tables_seconds;
+  double generation_seconds;
+  double writing_seconds;
+
+  // Tracing.
+  //    trace_writer      : where spans go (null when not tracing)
+  //    trace_expressions : whether ClassGenerators trace top-level expressions
+  //    main_trace        : spans of this thread, written as they close
+  std::unique_ptr<TraceWriter> trace_writer;
+  bool trace_expressions;
+  TraceBuffer main_trace;
+
+  // Dispatch structures, by method id in the tree's method table.
+  //    methods_returning   : class id -> methods declared to return it
+  //    self_type_methods   : class id -> methods it declares returning SELF_TYPE
+  //    type_dispatch_index : class id -> dispatches producing it
+  std::vector<std::vector<int> > methods_returning;
+  std::vector<std::vector<int> > self_type_methods;
+  std::vector<TypeDispatches> type_dispatch_index;
 };
 
 #endif
@@ -1,5 +1,5 @@
 // File         : ExpressionGenerator.cc
-// Description  : Implements the expression generator for CodeGenerator.cc.
+// Description  : Implements the expression generator for ClassGenerator.cc.
 
 #include <string>
 #include <iostream>
@@ -7,897 +7,661 @@
 #include <vector>
 #include "util.h"
 #include "CodeGenerator.h"
+#include "ClassGenerator.h"
 #include "NameGenerator.h"
+#include "Permutation.h"
 #include <algorithm>
-#include <random>
 #include <chrono>
 
 using namespace std;
 
+// FUNCTION: Returns a uniformly random type that conforms to @type.
+// NOTES: - The classes <= @type are one range of the preorder, so this is
+//          a single draw. SELF_TYPE is one more option when the current
+//          class <= @type.
+//        - SELF_TYPE (or any other non-class) only conforms to itself.
+string ClassGenerator::choose_subtype(string type) {
+  int type_id = tree.class_id(type);
+  if (type_id == -1) return type;
+  int num_subtypes = tree.class_subtree_size[type_id];
+  bool self_below = tree.is_child_of(current_class_id, type_id);
+  int index = rng.below(num_subtypes + (self_below ? 1 : 0));
+  if (index == num_subtypes) return "SELF_TYPE";
+  return tree.class_names[tree.subtype(type_id, index)];
+}
+
+// FUNCTION: Returns a uniformly random class name or SELF_TYPE.
+// NOTES: Draws the same index as picking from class_names plus
+//        SELF_TYPE, without building that list.
+string ClassGenerator::random_type() {
+  int index = rng.below(tree.class_names.size() + 1);
+  if (index == tree.class_names.size()) return "SELF_TYPE";
+  return tree.class_names[index];
+}
+
 // EXPRESSION: new.
-void CodeGenerator::generate_new(string type) {
-  writer << "new " << type;
-  current_line_length += 4 + type.length();
+bool ClassGenerator::generate_new(ExpressionFrame& frame) {
+  frame.node->type = tree.class_id(frame.type);
+  return false;
 }
 
 // EXPRESSION: Bool constant.
 // Notes: Generates true/false randomly and with equal probability.
-void CodeGenerator::generate_bool() {
-  if (rand() % 2 == 0) {
-    writer << "true";
-    current_line_length += 4;
-  } else {
-    writer << "false";
-    current_line_length += 5;
-  }
+bool ClassGenerator::generate_bool(ExpressionFrame& frame) {
+  frame.node->value = rng.below(2) == 0 ? 1 : 0;
+  return false;
 }
 
 // EXPRESSION: String constant.
 // Notes: Generates string of 0-10 characters randomly.
-void CodeGenerator::generate_string() {
-  int length = rand() % 11;
-  writer << '\"' << name_generator.generate_random_string(length) << '\"';
-  current_line_length += length + 2;
+bool ClassGenerator::generate_string(ExpressionFrame& frame) {
+  int length = rng.below(11);
+  frame.node->value = add_symbol(name_generator.generate_random_string(length, rng));
+  return false;
 }
 
 // EXPRESSION: Int constant.
 // Notes: Generates number between 0 and INT_MAX.
-void CodeGenerator::generate_int() {
-  int a = rand();
-  writer << a;
-  current_line_length += to_string(a).length();
+bool ClassGenerator::generate_int(ExpressionFrame& frame) {
+  frame.node->value = rng() >> 33;
+  return false;
+}
+
+// EXPRESSION: Identifier, for the expression of @frame.
+bool ClassGenerator::generate_identifier(ExpressionFrame& frame) {
+  generate_identifier(frame.type, false);
+  return false;
+}
+
+// EXPRESSION: Assignment, for the expression of @frame.
+// NOTES: Done once the assigned expression has been generated.
+bool ClassGenerator::generate_assignment(ExpressionFrame& frame) {
+  if (frame.step != 0) return false;
+  return generate_assignment(frame.type, false);
 }
 
 // EXPRESSION: Identifier.
 // NOTES: - If @abort_early is true, then this will return whether
 //          an identifier exists that can be used for @type.
-//        - If @abort_early is false, the return will be true on successful
-//          output (an exception will be thrown if no possible identifiers exist).
-bool CodeGenerator::generate_identifier(string type, bool abort_early) {
-
-  // Extract available locals.
-  vector<pair<string, string> > locals = identifiers.current_ids();
-
-  // Find possible identifiers.
-  vector<pair<string, string> > possible_identifiers = vector<pair<string, string> >();
+//        - If @abort_early is false, the chosen identifier goes in the node of
+//          the current frame and the return will be true (an exception will be
+//          thrown if no possible identifiers exist).
+//        - Identifiers are bucketed by type in preorder, so the ones that conform
+//          to @type are a contiguous range of buckets plus the SELF_TYPE bucket.
+bool ClassGenerator::generate_identifier(string type, bool abort_early) {
+
+  // Count possible identifiers.
+  int num_below = 0;
+  int num_self_type = 0;
+  int first = 0;
+  int last = 0;
   if (type == "SELF_TYPE") {
-    for (int i = 0; i < locals.size(); i++) {
-      if (locals[i].second == "SELF_TYPE") {
-        if (abort_early) return true;
-        possible_identifiers.push_back(locals[i]);
-      }
-    }
+    num_self_type = identifiers.bucket_size(self_type_bucket);
   } else {
-    for (int i = 0; i < locals.size(); i++) {
-      string identifier_type = locals[i].second;
-      if (identifier_type == "SELF_TYPE") {
-        identifier_type = current_class;
-      }
-
-      if (tree.is_child_of(identifier_type, type)) {
-        if (abort_early) return true;
-        possible_identifiers.push_back(locals[i]);
-      }
+    int type_id = tree.class_id(type);
+    first = tree.class_preorder[type_id];
+    last = first + tree.class_subtree_size[type_id];
+    num_below = identifiers.count_in_buckets(first, last);
+    if (tree.is_child_of(current_class_id, type_id)) {
+      num_self_type = identifiers.bucket_size(self_type_bucket);
     }
   }
 
-  // No possible identifiers found.
-  if (abort_early) return false;
+  if (abort_early) return num_below + num_self_type > 0;
 
-  if (possible_identifiers.size() == 0) {
+  if (num_below + num_self_type == 0) {
     throw "Internal Error: no identifiers match expression but generate_identifier was called.";
   }
 
-  // Choose identifier at random and print out.
-  string identifier = possible_identifiers[rand() % possible_identifiers.size()].first;
-  writer << identifier;
-  current_line_length += identifier.length();
+  // Choose identifier at random.
+  int index = rng.below(num_below + num_self_type);
+  string identifier;
+  if (index < num_below) {
+    identifier = identifiers.id_in_buckets(first, last, index).first;
+  } else {
+    identifier = identifiers.id_in_bucket(self_type_bucket, index - num_below);
+  }
+  frames[num_frames - 1].node->value = add_symbol(identifier);
 
   // Default return.
   return true;
 }
 
+// FUNCTION: Returns the number of expression types that an identifier
+// declared as @identifier_type can be assigned when the assignment
+// must conform to @type (-1 for SELF_TYPE in both).
+int ClassGenerator::assign_types_for(int identifier_type, int type) {
+  if (identifier_type == -1) return tree.is_child_of(current_class_id, type) ? 1 : 0;
+  int root = tree.is_child_of(identifier_type, type) ? identifier_type : type;
+  return tree.class_subtree_size[root] + (tree.is_child_of(current_class_id, root) ? 1 : 0);
+}
+
 // EXPRESSION: Assignment.
 // NOTES: - If @abort_early is true, then this will return whether
 //          an assignment exists that can be used for @type.
-//        - If @abort_early is false, the return will be true on successful
-//          output (an exception will be thrown if no possible assignments exist).
-bool CodeGenerator::generate_assignment(string type, bool abort_early) {
+//        - If @abort_early is false, the return will be true once the assigned
+//          expression is pushed (an exception will be thrown if no possible
+//          assignments exist).
+//        - Each (identifier, assign expression type) pair is equally likely. The
+//          identifiers that can take part are those declared below @type, above
+//          it (counted by covering buckets) or as SELF_TYPE; self never can.
+bool ClassGenerator::generate_assignment(string type, bool abort_early) {
 
-  // Extract available locals.
-  vector<pair<string, string> > locals = identifiers.current_ids();
-
-  // Choose possible assigns.
-  // NOTES: - The possible assigns are stored in a vector where elements are of the form
-  //          ((identifier name, identifier type), assign expression type)
-  vector<pair<pair<string, string>, string> > possible_assigns = vector<pair<pair<string, string>, string> >();
+  int self_bucket = tree.class_preorder[current_class_id];
+  int num_self_type = identifiers.bucket_size(self_type_bucket);
 
   if (type == "SELF_TYPE") {
-    for(int i = 0; i < locals.size(); i++) {
-      string identifier_type = locals[i].second;
-
-      // Can't assign to self.
-      if (locals[i].first == "self") continue;
 
-      if (identifier_type == "SELF_TYPE" || tree.is_child_of(current_class, identifier_type)) {
-        if (abort_early) return true;
-        possible_assigns.push_back(pair<pair<string, string>, string>(locals[i], "SELF_TYPE"));
-      }
-    }
-  } else {
-    set<string> possible_assign_types = tree.class_descendants[type];
-    possible_assign_types.insert(type);
-    if (tree.is_child_of(current_class, type)) {
-      possible_assign_types.insert("SELF_TYPE");
+    // Identifiers of SELF_TYPE or of an ancestor of the current class, except self.
+    int num_assigns = num_self_type + identifiers.count_covering(self_bucket) - 1;
+    if (abort_early) return num_assigns > 0;
+    if (num_assigns <= 0) {
+      throw "Internal Error: No possible assignments though generate_assignment was called.";
     }
 
-    for(set<string>::iterator it = possible_assign_types.begin();
-                              it != possible_assign_types.end(); ++it) {
-      string possible_type = *it;
-      if (possible_type == "SELF_TYPE") {
-        possible_type = current_class;
-      }
-
-      for (int i = 0; i < locals.size(); i++) {
-
-        string identifier_type = locals[i].second;
-
-        // Can't assign to self.
-        if (locals[i].first == "self") continue;
-
-        // If identifier is SELF_TYPE, we need assignment to be SELF_TYPE.
-        // Otherwise, if assignment is SELF_TYPE, we treat it as current class.
-        if (identifier_type == "SELF_TYPE") {
-          if (*it == "SELF_TYPE") {
-            if (abort_early) return true;
-            possible_assigns.push_back(pair<pair<string, string>, string>(locals[i], *it));
-          }
-        } else {
-          if (tree.is_child_of(possible_type, identifier_type)) {
-            if (abort_early) return true;
-            possible_assigns.push_back(pair<pair<string, string>, string>(locals[i], *it));
-          }
-        }
+    vector<string> possible_identifiers = vector<string>();
+    for (int i = 0; i < num_self_type; i++) {
+      possible_identifiers.push_back(identifiers.id_in_bucket(self_type_bucket, i));
+    }
+    for (int c = current_class_id; c != -1; c = tree.class_parent[c]) {
+      int bucket = tree.class_preorder[c];
+      for (int i = 0; i < identifiers.bucket_size(bucket); i++) {
+        string identifier = identifiers.id_in_bucket(bucket, i);
+        if (identifier != "self") possible_identifiers.push_back(identifier);
       }
     }
+    string identifier = possible_identifiers[rng.below(possible_identifiers.size())];
+    return add_assignment(identifier, "SELF_TYPE");
   }
 
-  // No possible assignments found.
-  if (abort_early) return false;
-
-  if (possible_assigns.size() == 0) {
+  int type_id = tree.class_id(type);
+  int type_bucket = tree.class_preorder[type_id];
+  bool self_below = tree.is_child_of(current_class_id, type_id);
+  bool self_above = !self_below && tree.is_child_of(type_id, current_class_id);
+
+  // Count identifiers that have at least one possible assignment.
+  int type_end = type_bucket + tree.class_subtree_size[type_id];
+  int num_below = identifiers.count_in_buckets(type_bucket, type_end);
+  int num_above = identifiers.count_covering(type_bucket) - identifiers.bucket_size(type_bucket);
+  int num_assigns = num_below + num_above - (self_below || self_above ? 1 : 0);
+  if (self_below) num_assigns += num_self_type;
+  if (abort_early) return num_assigns > 0;
+  if (num_assigns <= 0) {
     throw "Internal Error: No possible assignments though generate_assignment was called.";
   }
 
-  // Choose assignment randomly and output result.
-  pair<pair<string, string>, string> assign = possible_assigns[rand() % possible_assigns.size()];
-  writer << assign.first.first << " <- (";
-  current_line_length += assign.first.first.length() + 5;
-
-  if (current_line_length >= max_line_length) {
-    writer << endl;
-    indentation_tabs++;
-    print_tabs();
-    generate_expression(assign.second);
-    indentation_tabs--;
-    writer << endl;
-    print_tabs();
-    writer << ")";
-  } else {
-    generate_expression(assign.second);
-    writer << ")";
+  // Weigh each identifier by its number of possible assign expression types.
+  // NOTES: - The possible assigns are stored in a vector where elements are of the form
+  //          ((identifier name, identifier type id), cumulative assign count)
+  vector<pair<pair<string, int>, long long> > possible_assigns = vector<pair<pair<string, int>, long long> >();
+  long long total = 0;
+  for (int i = 0; i < num_below; i++) {
+    pair<string, int> identifier = identifiers.id_in_buckets(type_bucket, type_end, i);
+    if (identifier.first == "self") continue;
+    int identifier_type = tree.preorder_classes[identifier.second];
+    total += assign_types_for(identifier_type, type_id);
+    possible_assigns.push_back(pair<pair<string, int>, long long>(
+      pair<string, int>(identifier.first, identifier_type), total));
   }
 
-  // Default return.
-  return true;
+  // Identifiers above @type sit in the buckets of its strict ancestors.
+  for (int c = tree.class_parent[type_id]; c != -1; c = tree.class_parent[c]) {
+    int bucket = tree.class_preorder[c];
+    for (int i = 0; i < identifiers.bucket_size(bucket); i++) {
+      string identifier = identifiers.id_in_bucket(bucket, i);
+      if (identifier == "self") continue;
+      total += assign_types_for(c, type_id);
+      possible_assigns.push_back(pair<pair<string, int>, long long>(
+        pair<string, int>(identifier, c), total));
+    }
+  }
+  if (self_below) {
+    for (int i = 0; i < num_self_type; i++) {
+      total += assign_types_for(-1, type_id);
+      possible_assigns.push_back(pair<pair<string, int>, long long>(
+        pair<string, int>(identifiers.id_in_bucket(self_type_bucket, i), -1), total));
+    }
+  }
+
+  // Choose assignment randomly: first the identifier, then the expression
+  // type among the classes below its root (and SELF_TYPE, when it conforms).
+  long long index = rng.below(total);
+  int chosen = upper_bound(possible_assigns.begin(), possible_assigns.end(), index,
+    [](long long value, const pair<pair<string, int>, long long>& assign) {
+      return value < assign.second;
+    }) - possible_assigns.begin();
+  long long offset = index - (chosen == 0 ? 0 : possible_assigns[chosen - 1].second);
+  int identifier_type = possible_assigns[chosen].first.second;
+  string assign_type = "SELF_TYPE";
+  if (identifier_type != -1) {
+    int root = tree.is_child_of(identifier_type, type_id) ? identifier_type : type_id;
+    if (offset < tree.class_subtree_size[root]) {
+      assign_type = tree.class_names[tree.subtype(root, offset)];
+    }
+  }
+  return add_assignment(possible_assigns[chosen].first.first, assign_type);
 }
 
-// EXPRESSION: Dispatch.
-// NOTES: - This updates the internal class structures storing information
-//          about dispatches.
-void CodeGenerator::generate_dispatch_structures(string type) {
-
-  // Reset data structures.
-  static_dispatches = vector<pair<pair<string, string>, pair<string, string> > >();
-  dispatches = vector<pair<string, pair<string, string> > >();
-  self_dispatches = vector<pair<string, string> >();
-
-  // Iterate through all methods in all classes.
-  for (int i = 0; i < tree.class_names.size(); i++) {
-    string class_name = tree.class_names[i];
-    vector<string> class_methods = tree.class_method_names[class_name];
-    for (int j = 0; j < class_methods.size(); j++) {
-      string method_name = class_methods[j];
-      pair<string, string> method_signature = pair<string, string>(class_name, method_name);
-      string return_type = tree.class_method_types[class_name][method_name];
-
-      // Case 1: We need the dispatch to conform to SELF_TYPE.
-      //          - This can only occur if the return type of the method is
-      //            SELF_TYPE and the object it is called on is of type SELF_TYPE.
-      //          - No such thing as a static dispatch to SELF_TYPE.
-
-      if (type == "SELF_TYPE") {
-        if (return_type == "SELF_TYPE") {
-
-          // Self.
-          if (tree.is_child_of(current_class, class_name)) {
-            self_dispatches.push_back(method_signature);
-          }
-
-          // Regular.
-          if (tree.is_child_of(current_class, class_name)) {
-            dispatches.push_back(pair<string, pair<string, string> >("SELF_TYPE", method_signature));
-          }
-        }
-      }
+// FUNCTION: Makes the current frame an assignment of an expression of
+// @assign_type to @identifier, and pushes that expression.
+bool ClassGenerator::add_assignment(string identifier, string assign_type) {
+  ExpressionFrame& frame = frames[num_frames - 1];
+  ExpressionNode* node = frame.node;
+  node->value = add_symbol(identifier);
+  add_children(frame, 1);
+  frame.step = 1;
+  node->children[0] = push_expression(assign_type);
+  return true;
+}
 
-      // Case 2: The type we need to expand to is not SELF_TYPE.
-      //          - (2a) If the method returns SELF_TYPE then we have cases:
-      //            * self: we need @current_class <= @type and
-      //                            @current_class <= @class_name
-      //            * static: consider A@B.m(). Then we need
-      //                      B <= @class_name
-      //                      A <= B
-      //                      B <= @type.
-      //            * regular: consider A.m(). Then we need
-      //                      A <= @class_name
-      //                      A <= @type.
-      //          - (2b) If the method returns type C:
-      //            * self: we need C <= @type
-      //                            @current_class <= @class_name.
-      //            * static: consider A@B.m(). Then we need
-      //                      C <= @type
-      //                      B <= @class_name
-      //                      A <= B.
-      //            * regular: consider A.m(). Then we need
-      //                      C <= @type
-      //                      A <= @class_name.
-
-      if (type != "SELF_TYPE") {
-
-        // Case 2a.
-        if (return_type == "SELF_TYPE") {
-
-          // Self.
-          if (tree.is_child_of(current_class, class_name) && tree.is_child_of(current_class, type)) {
-            self_dispatches.push_back(method_signature);
-          }
-
-          // Static.
-          set<string> type_children = tree.class_descendants[type];
-          type_children.insert(type);
-          for(set<string>::iterator it = type_children.begin(); it != type_children.end(); ++it) {
-            string possible_static_type = *it;
-            if (!tree.is_child_of(possible_static_type, class_name)) continue;
-            set<string> static_type_children = tree.class_descendants[possible_static_type];
-            static_type_children.insert(possible_static_type);
-            for(set<string>::iterator it2 = static_type_children.begin(); it2 != static_type_children.end(); ++it2) {
-              string expression_type = *it2;
-              pair<string, string> static_signature = pair<string, string>(expression_type, possible_static_type);
-              static_dispatches.push_back(pair<pair<string, string>, pair<string, string> >(static_signature, method_signature));
-            }
-          }
-
-          // Regular.
-          for(set<string>::iterator it = type_children.begin(); it != type_children.end(); ++it) {
-            string possible_type = *it;
-            if (!tree.is_child_of(possible_type, class_name)) continue;
-            dispatches.push_back(pair<string, pair<string, string> >(possible_type, method_signature));
-          }
-        }
+// FUNCTION: Returns whether self.m() conforms to @type_id (-1 for SELF_TYPE).
+// NOTES: - Only methods of the current class and its ancestors are considered.
+//        - To conform to SELF_TYPE, m must return SELF_TYPE.
+//        - Otherwise, a SELF_TYPE return conforms if @current_class <= @type,
+//          and a return type C conforms if C <= @type.
+bool ClassGenerator::self_dispatch_conforms(int method_index, int type_id) {
+  int return_type = tree.method_return_types[method_index];
+  if (type_id == -1) return return_type == -1;
+  if (return_type == -1) return tree.is_child_of(current_class_id, type_id);
+  return tree.is_child_of(return_type, type_id);
+}
 
-        // Case 2b.
-        if (return_type != "SELF_TYPE") {
-          if (tree.is_child_of(return_type, type)) {
-
-            // Self.
-            if (tree.is_child_of(current_class, class_name)) {
-              self_dispatches.push_back(method_signature);
-            }
-
-            // Static.
-            set<string> type_children = tree.class_descendants[class_name];
-            type_children.insert(class_name);
-            for(set<string>::iterator it = type_children.begin(); it != type_children.end(); ++it) {
-              string possible_static_type = *it;
-              if (!tree.is_child_of(possible_static_type, class_name)) continue;
-              set<string> static_type_children = tree.class_descendants[possible_static_type];
-              static_type_children.insert(possible_static_type);
-              for(set<string>::iterator it2 = static_type_children.begin(); it2 != static_type_children.end(); ++it2) {
-                string expression_type = *it2;
-                pair<string, string> static_signature = pair<string, string>(expression_type, possible_static_type);
-                static_dispatches.push_back(pair<pair<string, string>, pair<string, string> >(static_signature, method_signature));
-              }
-            }
-
-            // Regular.
-            for(set<string>::iterator it = type_children.begin(); it != type_children.end(); ++it) {
-              string possible_type = *it;
-              if (!tree.is_child_of(possible_type, class_name)) continue;
-              dispatches.push_back(pair<string, pair<string, string> >(possible_type, method_signature));
-            }
-          }
-        }
-      }
-    }
+// FUNCTION: Returns the @n-th method in the vtable of the current class
+//           that self can dispatch to for @type_id.
+int ClassGenerator::nth_self_dispatch(int type_id, long long n) {
+  for (int i = tree.vtable_starts[current_class_id]; i < tree.vtable_starts[current_class_id + 1]; i++) {
+    int method_index = tree.vtable_methods[i];
+    if (!self_dispatch_conforms(method_index, type_id)) continue;
+    if (n == 0) return method_index;
+    n--;
   }
+  throw "Internal Error: self dispatch index out of range.";
 }
 
 // EXPRESSION: Dispatch.
-// NOTES: - This writes out a dispatch with the assumption that the
-//          internal structures are updated (with a call to generate_dispatch_structures).
-//        - @dispatch_type has three possible values:
-//          * 'self' for a self-dispatch (e.g., method_name(args)).
-//          * 'static' for a static dispatch (e.g., <expr>@<type>.method(args)).
-//          * 'regular' for a normal dispatch (e.g., <expr>.method(args)).
-void CodeGenerator::write_dispatch(string dispatch_type) {
-  string class_name, method_name;
-
-  if (dispatch_type == "self") {
-    if (self_dispatches.size() == 0) {
-      throw "Internal Error: self_dispatches is empty during write_dispatch(\"self\") call.";
-    }
-    pair<string, string> dispatch = self_dispatches[rand() % self_dispatches.size()];
-    class_name = dispatch.first;
-    method_name = dispatch.second;
-  } else if (dispatch_type == "static") {
-    if (static_dispatches.size() == 0) {
-      throw "Internal Error: static_dispatches is empty during write_dispatch(\"static\") call.";
-    }
-    pair<pair<string, string>, pair<string, string> > dispatch = static_dispatches[rand() % static_dispatches.size()];
-    class_name = dispatch.second.first;
-    method_name = dispatch.second.second;
-
-    // Write output.
-    writer << '(';
-    current_line_length += 1;
-    if (current_line_length >= max_line_length) {
-      writer << endl;
-      print_tabs();
-      generate_expression(dispatch.first.first);
-      writer << endl;
-      print_tabs();
-    } else {
-      generate_expression(dispatch.first.first);
-    }
-    writer << ")@" << dispatch.first.second << '.';
-    current_line_length += 3 + dispatch.first.second.length();
-
-  } else if (dispatch_type == "regular") {
-    if (dispatches.size() == 0) {
-      throw "Internal Error: dispatches is empty during write_dispatch(\"regular\") call.";
-    }
-    pair<string, pair<string, string> > dispatch = dispatches[rand() % dispatches.size()];
-    class_name = dispatch.second.first;
-    method_name = dispatch.second.second;
-
-    // Write output.
-    writer << '(';
-    current_line_length += 1;
-    if (current_line_length >= max_line_length) {
-      writer << endl;
-      print_tabs();
-      generate_expression(dispatch.first);
-      writer << endl;
-      print_tabs();
-    } else {
-      generate_expression(dispatch.first);
+// NOTES: - This counts the self, regular and static dispatches that produce
+//          @type without listing them, and remembers @type for write_dispatch.
+//        - A dispatch conforms to SELF_TYPE only if the method returns
+//          SELF_TYPE and is called on an object of type SELF_TYPE (self
+//          or regular). There is no such thing as a static dispatch to SELF_TYPE.
+void ClassGenerator::count_dispatches(string type) {
+  dispatch_target = tree.class_id(type);
+
+  // Self dispatches (memoized per class).
+  map<int, long long>::iterator it = self_dispatch_counts.find(dispatch_target);
+  if (it == self_dispatch_counts.end()) {
+    long long count = 0;
+    for (int i = tree.vtable_starts[current_class_id]; i < tree.vtable_starts[current_class_id + 1]; i++) {
+      if (self_dispatch_conforms(tree.vtable_methods[i], dispatch_target)) count++;
     }
-    writer << ").";
-    current_line_length += 2;
-
-  } else {
-    throw "Internal Error: dispatch_type must be one of \"self\", \"static\", \"regular\".";
+    it = self_dispatch_counts.insert(pair<int, long long>(dispatch_target, count)).first;
   }
+  self_dispatch_count = it->second;
 
-  vector<pair<string, string> > arguments = tree.class_method_args[class_name][method_name];
-  writer << method_name << '(';
-  current_line_length += method_name.length() + 1;
-
-  // Print on other lines if enough arguments / line too long.
-  if (arguments.size() >= 3 || current_line_length >= max_line_length) {
-    writer << endl;
-    indentation_tabs++;
-    for (int i = 0; i < arguments.size(); i++) {
-      print_tabs();
-      generate_expression(arguments[i].second);
-      if (i != arguments.size() - 1) writer << ',';
-      writer << endl;
-    }
-    indentation_tabs--;
-    print_tabs();
-    writer << ')';
+  // Regular and static dispatches.
+  if (dispatch_target == -1) {
+    dispatch_count = self_dispatch_count;
+    static_dispatch_count = 0;
   } else {
-    for (int i = 0; i < arguments.size(); i++) {
-      generate_expression(arguments[i].second);
-      if (i != arguments.size() - 1) {
-        writer << ", ";
-        current_line_length += 2;
-      }
-    }
-    writer << ')';
-    current_line_length++;
+    const TypeDispatches& candidates = type_dispatch_index[dispatch_target];
+    stats.dispatch_lookups++;
+    stats.dispatch_candidates += candidates.methods.size();
+    stats.max_dispatch_candidates = max(stats.max_dispatch_candidates, (long long) candidates.methods.size());
+    dispatch_count = candidates.dispatch_counts.empty() ? 0 : candidates.dispatch_counts.back();
+    static_dispatch_count = candidates.static_dispatch_counts.empty() ?
+                              0 : candidates.static_dispatch_counts.back();
   }
 }
 
-// EXPRESSION: Conditional.
-void CodeGenerator::generate_conditional(string type) {
-  // Generate all possible conditional expressions.
-  // We keep track of this with a vector where the entry
-  //  (a,b) represents if (bool) then (type a) else (type b).
-  vector<pair<string, string> > possible_conditionals = vector<pair<string, string> >();
+// EXPRESSION: Dispatch.
+// NOTES: - This builds a dispatch with the assumption that the
+//          dispatch counts are up to date (with a call to count_dispatches).
+//        - The expansion of the frame tells the kind of dispatch:
+//          * SelfDispatch (e.g., method_name(args)).
+//          * StaticDispatch (e.g., <expr>@<type>.method(args)).
+//          * Dispatch (e.g., <expr>.method(args)).
+//        - Every candidate is equally likely.
+//        - The object expression (if any) is the first child, then come
+//          the arguments.
+bool ClassGenerator::generate_dispatch(ExpressionFrame& frame) {
+  if (frame.step == 0) {
+    ExpressionNode* node = frame.node;
+    string expression_type = "";
+
+    if (node->expansion == SelfDispatch) {
+      if (self_dispatch_count == 0) {
+        throw "Internal Error: no self dispatches during generate_dispatch call.";
+      }
+      node->value = nth_self_dispatch(dispatch_target, rng.below(self_dispatch_count));
 
-  // Case 1: type is SELF_TYPE and both branches must then be SELF_TYPE.
-  if (type == "SELF_TYPE") {
-    possible_conditionals.push_back(pair<string, string>("SELF_TYPE", "SELF_TYPE"));
-  }
+    } else if (node->expansion == StaticDispatch) {
+      if (static_dispatch_count == 0) {
+        throw "Internal Error: no static dispatches during generate_dispatch call.";
+      }
 
-  // Case 2: type is not SELF_TYPE.
-  if (type != "SELF_TYPE") {
+      // Choose the method, then the (expression type, static type) pair below its root.
+      const TypeDispatches& candidates = type_dispatch_index[dispatch_target];
+      long long index = rng.below(static_dispatch_count);
+      int i = upper_bound(candidates.static_dispatch_counts.begin(),
+                          candidates.static_dispatch_counts.end(), index)
+                - candidates.static_dispatch_counts.begin();
+      if (i > 0) index -= candidates.static_dispatch_counts[i - 1];
+      pair<int, int> dispatch = tree.nested_pair(candidates.object_roots[i], index);
+      node->value = candidates.methods[i];
+      node->type = dispatch.second;
+      expression_type = tree.class_names[dispatch.first];
 
-    // The branches have the same type possibilities.
-    set<string> possible_branch_types = tree.class_descendants[type];
-    possible_branch_types.insert(type);
+    } else {
+      if (dispatch_count == 0) {
+        throw "Internal Error: no dispatches during generate_dispatch call.";
+      }
 
-    // We can add SELF_TYPE if the current class <= type.
-    if (tree.is_child_of(current_class, type)) {
-      possible_branch_types.insert("SELF_TYPE");
+      // Choose the method, then the expression type below its root.
+      long long index = rng.below(dispatch_count);
+      if (dispatch_target == -1) {
+        node->value = nth_self_dispatch(dispatch_target, index);
+        expression_type = "SELF_TYPE";
+      } else {
+        const TypeDispatches& candidates = type_dispatch_index[dispatch_target];
+        int i = upper_bound(candidates.dispatch_counts.begin(),
+                            candidates.dispatch_counts.end(), index)
+                  - candidates.dispatch_counts.begin();
+        if (i > 0) index -= candidates.dispatch_counts[i - 1];
+        int root = candidates.object_roots[i];
+        node->value = candidates.methods[i];
+        expression_type = tree.class_names[tree.subtype(root, index)];
+      }
     }
 
-    for (set<string>::iterator it = possible_branch_types.begin(); it != possible_branch_types.end(); ++it) {
-      string possible_then_type = *it;
-      for (set<string>::iterator it2 = possible_branch_types.begin(); it2 != possible_branch_types.end(); ++it2) {
-        string possible_else_type = *it2;
-        possible_conditionals.push_back(pair<string, string>(possible_then_type, possible_else_type));
-      }
+    // Children: the object expression, then the arguments.
+    int first_arg = tree.method_arg_starts[node->value];
+    int num_args = tree.method_arg_starts[node->value + 1] - first_arg;
+    if (expression_type != "") frame.types.push_back(expression_type);
+    for (int i = 0; i < num_args; i++) {
+      frame.types.push_back(tree.class_names[tree.method_arg_types[first_arg + i]]);
     }
+    add_children(frame, frame.types.size());
+    frame.step = 1;
   }
+  return push_next_child(frame);
+}
 
-  // Choose conditional.
-  pair<string, string> branch_types = possible_conditionals[rand() % possible_conditionals.size()];
-  string then_type = branch_types.first;
-  string else_type = branch_types.second;
-
-  // Write output.
-
-  //    if (bool) {
-  writer << "if (";
-  current_line_length += 4;
-  generate_expression("Bool");
-  writer << ") then (" << endl;
-
-  //       then_type
-  //    } else {
-  indentation_tabs++;
-  print_tabs();
-  generate_expression(then_type);
-  writer << endl;
-  indentation_tabs--;
-  print_tabs();
-  writer << ") else (" << endl;
-
-  //      else_type
-  //    }
-  indentation_tabs++;
-  print_tabs();
-  generate_expression(else_type);
-  writer << endl;
-  indentation_tabs--;
-  print_tabs();
-  writer << ") fi";
-  current_line_length += 4;
+// EXPRESSION: Conditional.
+// NOTES: Children are the predicate and the two branches.
+bool ClassGenerator::generate_conditional(ExpressionFrame& frame) {
+  if (frame.step == 0) {
+
+    // Each branch independently takes a type conforming to @type.
+    // If @type is SELF_TYPE, both branches must then be SELF_TYPE.
+    frame.types.push_back("Bool");
+    frame.types.push_back(choose_subtype(frame.type));
+    frame.types.push_back(choose_subtype(frame.type));
+    add_children(frame, 3);
+    frame.step = 1;
+  }
+  return push_next_child(frame);
 }
 
 // EXPRESSION: Loop.
-void CodeGenerator::generate_loop() {
-
-  // Randomly choose the static type of the body.
-  vector<string> possible_body_types = tree.class_names;
-  possible_body_types.push_back("SELF_TYPE");
-  string body_type = possible_body_types[rand() % possible_body_types.size()];
-
-  // Output result.
-  writer << "while (";
-  current_line_length += 7;
-  if (current_line_length >= max_line_length) {
-    writer << endl;
-    indentation_tabs++;
-    print_tabs();
-    generate_expression("Bool");
-    writer << endl;
-    indentation_tabs--;
-    print_tabs();
-  } else {
-    generate_expression("Bool");
-  }
-  writer << ") loop (";
-  current_line_length += 8;
-  if (current_line_length >= max_line_length) {
-    writer << endl;
-    indentation_tabs++;
-    print_tabs();
-    generate_expression(body_type);
-    writer << endl;
-    indentation_tabs--;
-    print_tabs();
-  } else {
-    generate_expression(body_type);
+// NOTES: Children are the predicate and the body.
+bool ClassGenerator::generate_loop(ExpressionFrame& frame) {
+  if (frame.step == 0) {
+
+    // Randomly choose the static type of the body.
+    frame.types.push_back("Bool");
+    frame.types.push_back(random_type());
+    add_children(frame, 2);
+    frame.step = 1;
   }
-  writer << ") pool";
-  current_line_length += 6;
+  return push_next_child(frame);
 }
 
 // EXPRESSION: Block.
-void CodeGenerator::generate_block(string type) {
-
-  // Choose number of lines in block.
-  int num_lines = (rand() % (max_block_length - 1)) + 1;
-
-  // Compute possible expression types.
-  vector<string> possible_types = tree.class_names;
-  possible_types.push_back("SELF_TYPE");
-  set<string> possible_last_types = tree.class_descendants[type];
-  possible_last_types.insert(type);
-  if (tree.is_child_of(current_class, type)) {
-    possible_last_types.insert("SELF_TYPE");
+// NOTES: The type of each line is drawn once the lines before it are done.
+bool ClassGenerator::generate_block(ExpressionFrame& frame) {
+  if (frame.step == 0) {
+
+    // Choose number of lines in block.
+    add_children(frame, rng.below(max_block_length - 1) + 1);
+    frame.step = 1;
   }
 
-  // Output block.
-  writer << "{" << endl;
-  indentation_tabs++;
-  for (int i = 0; i < num_lines; i++) {
-    print_tabs();
-    string current;
-    if (i == num_lines - 1) {
-      set<string>::iterator it = possible_last_types.begin();
-      advance(it, rand() % possible_last_types.size());
-      current = *it;
-    } else {
-      current = possible_types[rand() % possible_types.size()];
-    }
-    generate_expression(current);
-    writer << ';' << endl;
+  ExpressionNode* node = frame.node;
+  int i = frame.index;
+  if (i == node->num_children) return false;
+  string current;
+  if (i == node->num_children - 1) {
+    current = choose_subtype(frame.type);
+  } else {
+
+    current = random_type();
   }
-  indentation_tabs--;
-  print_tabs();
-  writer << '}';
-  current_line_length++;
+  frame.index++;
+  node->children[i] = push_expression(current);
+  return true;
 }
 
 // EXPRESSION: isVoid.
-void CodeGenerator::generate_isvoid() {
-
-  // Choose expression type.
-  vector<string> possible_types = tree.class_names;
-  possible_types.push_back("SELF_TYPE");
-  string type = possible_types[rand() % possible_types.size()];
-
-  // Output expression.
-  writer << "isvoid (";
-  current_line_length += 8;
-  if (current_line_length >= max_line_length) {
-    writer << endl;
-    indentation_tabs++;
-    print_tabs();
-    generate_expression(type);
-    writer << endl;
-    indentation_tabs--;
-    print_tabs();
-  } else {
-    generate_expression(type);
+bool ClassGenerator::generate_isvoid(ExpressionFrame& frame) {
+  if (frame.step == 0) {
+
+    // Choose expression type.
+    frame.types.push_back(random_type());
+    add_children(frame, 1);
+    frame.step = 1;
   }
-  writer << ')';
-  current_line_length++;
+  return push_next_child(frame);
 }
 
+// Operators of arithmetic and comparisons, by node value.
+const char* arithmetic_operations[] = {"+", "-", "/", "*"};
+const char* comparison_operations[] = {"<", "<=", "="};
+
 // EXPRESSION: Arithmetic.
-void CodeGenerator::generate_arithmetic() {
-
-  // Choose operation.
-  string ops_arr[] = {"+", "-", "/", "*"};
-  vector<string> ops (ops_arr, ops_arr + 4);
-  string operation = ops[rand() % ops.size()];
-
-  // Write result.
-  writer << "(";
-  current_line_length++;
-  generate_expression("Int");
-  writer << ") " + operation + " (";
-  current_line_length += 5;
-  generate_expression("Int");
-  writer << ")";
-  current_line_length++;
+bool ClassGenerator::generate_arithmetic(ExpressionFrame& frame) {
+  if (frame.step == 0) {
+
+    // Choose operation.
+    frame.node->value = rng.below(4);
+    frame.types.push_back("Int");
+    frame.types.push_back("Int");
+    add_children(frame, 2);
+    frame.step = 1;
+  }
+  return push_next_child(frame);
 }
 
 // EXPRESSION: Comparison.
-void CodeGenerator::generate_comparison() {
-
-  // Choose comparison.
-  string ops_arr[] = {"<", "<=", "="};
-  vector<string> ops (ops_arr, ops_arr + 3);
-  string operation = ops[rand() % ops.size()];
+bool ClassGenerator::generate_comparison(ExpressionFrame& frame) {
+  if (frame.step == 0) {
 
-  string first_type;
-  string second_type;
+    // Choose comparison.
+    int operation = rng.below(3);
 
-  if (operation == "=") {
-    vector<string> possible_types = tree.class_names;
-    possible_types.push_back("SELF_TYPE");
-
-    // We remove Object, because that could expand to one of Int, String, Bool.
-    for (int i = 0; i < possible_types.size(); i++) {
-      if (possible_types[i] == "Object") {
-        possible_types.erase(possible_types.begin() + i);
-        break;
-      }
-    }
+    string first_type;
+    string second_type;
 
-    first_type = possible_types[rand() % possible_types.size()];
-    if (first_type == "Int" || first_type == "String" || first_type == "Bool") {
-      second_type = first_type;
-    } else {
+    if (comparison_operations[operation] == string("=")) {
 
-      // First type is not Int, String, or Bool,
-      // so second type cannot be an Int, String,
-      // or Bool. Remove these from the vector.
+      // Not Object, because that could expand to one of Int, String, Bool.
+      // Types are redrawn rather than removed from a copy of the class names.
+      do {
+        first_type = random_type();
+      } while (first_type == "Object");
+      if (first_type == "Int" || first_type == "String" || first_type == "Bool") {
+        second_type = first_type;
+      } else {
 
-      for (int i = possible_types.size() - 1; i >= 0; i--) {
-        if (possible_types[i] == "Int" || possible_types[i] == "String" || possible_types[i] == "Bool") {
-          possible_types.erase(possible_types.begin() + i);
-        }
+        // First type is not Int, String, or Bool,
+        // so second type cannot be one either.
+        do {
+          second_type = random_type();
+        } while (second_type == "Object" || second_type == "Int" ||
+                 second_type == "String" || second_type == "Bool");
       }
-      second_type = possible_types[rand() % possible_types.size()];
+    } else {
+      first_type = "Int";
+      second_type = "Int";
     }
-  } else {
-    first_type = "Int";
-    second_type = "Int";
+    frame.node->value = operation;
+    frame.types.push_back(first_type);
+    frame.types.push_back(second_type);
+    add_children(frame, 2);
+    frame.step = 1;
   }
-
-  writer << "(";
-  current_line_length++;
-  generate_expression(first_type);
-  writer << ") " << operation << " (";
-  current_line_length += 4 + operation.length();
-  generate_expression(second_type);
-  writer << ")";
-  current_line_length++;
+  return push_next_child(frame);
 }
 
 // EXPRESSION: Boolean complement.
-void CodeGenerator::generate_bool_complement() {
-  writer << "not (";
-  current_line_length += 5;
-  generate_expression("Bool");
-  writer << ")";
-  current_line_length++;
+bool ClassGenerator::generate_bool_complement(ExpressionFrame& frame) {
+  if (frame.step == 0) {
+    frame.types.push_back("Bool");
+    add_children(frame, 1);
+    frame.step = 1;
+  }
+  return push_next_child(frame);
 }
 
 // EXPRESSION: Integer complement.
-void CodeGenerator::generate_int_complement() {
-  writer << "~(";
-  current_line_length += 2;
-  generate_expression("Int");
-  writer << ")";
-  current_line_length++;
+bool ClassGenerator::generate_int_complement(ExpressionFrame& frame) {
+  if (frame.step == 0) {
+    frame.types.push_back("Int");
+    add_children(frame, 1);
+    frame.step = 1;
+  }
+  return push_next_child(frame);
 }
 
 // EXPRESSION: Let.
-void CodeGenerator::generate_let(string type) {
-
-
-  // Choose number of definitions.
-  int num_defines = (rand() % (max_let_defines - 1)) + 1;
-
-  // Enter scope.
-  identifiers.enter_scope();
-
-  // For each definition, generate:
-  //  - A name for the variable.
-  //  - A type for the variable.
-  //  - An initialization for the variable (NULL if not initialized).
-  vector<pair<string, pair<string, string> > > let_defines = vector<pair<string, pair<string, string> > >();
-  for (int i = 0; i < num_defines; i++) {
-
-    // No illegal names for let variables.
-    vector<string> illegal_names = vector<string>();
-    string var_name = name_generator.generate(variable, illegal_names);
-    vector<string> possible_types = tree.class_names;
-    possible_types.push_back("SELF_TYPE");
-    string var_type = possible_types[rand() % possible_types.size()];
-
-    // Choose initialization type.
-    double cutoff = ((double) rand() / (RAND_MAX));
-    string init_type = "";
-    if (cutoff <= probability_initialized) {
-
-      // The only way to init a SELF_TYPE is with a SELF_TYPE.
-      if (var_type == "SELF_TYPE") {
-        init_type = "SELF_TYPE";
-      } else {
-        set<string> descendants = tree.class_descendants[var_type];
-        descendants.insert(var_type);
-        if (tree.is_child_of(current_class, var_type)) {
-          descendants.insert("SELF_TYPE");
+// NOTES: - Children are each define's initialization (NULL if not
+//          initialized), then the body. @frame.types holds their types.
+//        - Step 1 starts define @frame.index (or the body), step 2
+//          follows it and step 3 follows the body.
+bool ClassGenerator::generate_let(ExpressionFrame& frame) {
+  while (true) {
+    if (frame.step == 0) {
+
+      // Choose number of definitions.
+      int num_defines = rng.below(max_let_defines - 1) + 1;
+      ExpressionNode* node = frame.node;
+      node->num_bindings = num_defines;
+      node->bindings = arena.make_array<int>(2 * num_defines);
+
+      // Enter scope.
+      identifiers.enter_scope();
+
+      // For each definition, generate:
+      //  - A name for the variable.
+      //  - A type for the variable.
+      //  - An initialization for the variable ("" if not initialized).
+      for (int i = 0; i < num_defines; i++) {
+
+        // No illegal names for let variables.
+        vector<string> illegal_names = vector<string>();
+        string var_name = name_generator.generate(variable, illegal_names, rng);
+        string var_type = random_type();
+
+        // Choose initialization type.
+        string init_type = "";
+        if (rng.uniform() < probability_initialized) {
+
+          // The only way to init a SELF_TYPE is with a SELF_TYPE.
+          init_type = choose_subtype(var_type);
         }
-        set<string>::iterator it = descendants.begin();
-        advance(it, rand() % descendants.size());
-        init_type = *it;
-      }
-    }
 
-    // Update data structures.
-    pair<string, string> types = pair<string, string>(var_type, init_type);
-    let_defines.push_back(pair<string, pair<string, string> >(var_name, types));
-  }
-
-  // Choose body type.
-  string body_type;
-  if (type == "SELF_TYPE") {
-    body_type = "SELF_TYPE";
-  } else {
-    set<string> possible_body_types = tree.class_descendants[type];
-    possible_body_types.insert(type);
-    if (tree.is_child_of(current_class, type)) {
-      possible_body_types.insert("SELF_TYPE");
-    }
-    set<string>::iterator it = possible_body_types.begin();
-    advance(it, rand() % possible_body_types.size());
-    body_type = *it;
-  }
-
-  // Case 1: Pretty printing without space.
-  if (current_line_length >= max_line_length || num_defines > 2) {
-
-    // Print let on new line by itself.
-    writer << endl;
-    indentation_tabs++;
-    print_tabs();
-    writer << "let " << endl;
-    indentation_tabs++;
-
-    // Print statements.
-    for (int i = 0; i < let_defines.size(); i++) {
-      print_tabs();
-      pair<string, pair<string, string> > let_define = let_defines[i];
-      writer << let_define.first << " : " << let_define.second.first;
-
-      // Initialization.
-      if (let_define.second.second.length() > 0) {
-        writer << " <- ";
-        current_line_length += let_define.first.length() + let_define.second.first.length() + 7;
-        generate_expression(let_define.second.second);
+        // Update data structures.
+        node->bindings[2 * i] = add_symbol(var_name);
+        node->bindings[2 * i + 1] = tree.class_id(var_type);
+        frame.types.push_back(init_type);
       }
 
-      // No comma on last iteration.
-      if (i != let_defines.size() - 1) {
-        writer << ',';
+      // Choose body type.
+      frame.types.push_back(choose_subtype(frame.type));
+      add_children(frame, num_defines + 1);
+      frame.step = 1;
+
+    } else if (frame.step == 1) {
+      ExpressionNode* node = frame.node;
+      int i = frame.index;
+      frame.step = (i == node->num_bindings) ? 3 : 2;
+      if (frame.types[i].length() > 0) {
+        node->children[i] = push_expression(frame.types[i]);
+        return true;
       }
-      writer << endl;
-
-      identifiers.add_id(let_define.first, let_define.second.first);
-    }
-
-    indentation_tabs--;
-    print_tabs();
 
-    // Print body
-    writer << "in" << endl;
-    indentation_tabs++;
-    print_tabs();
-    generate_expression(body_type);
-    writer << endl;
-    indentation_tabs -= 2;
-    print_tabs();
+    } else if (frame.step == 2) {
+      ExpressionNode* node = frame.node;
+      int i = frame.index;
+      identifiers.add_id(symbols[node->bindings[2 * i]], tree.type_name(node->bindings[2 * i + 1]));
+      frame.index++;
+      frame.step = 1;
 
-  } else {
-
-    // Print let.
-    writer << "let ";
-
-    // Print defines.
-    for (int i = 0; i < let_defines.size(); i++) {
-      pair<string, pair<string, string> > let_define = let_defines[i];
-      writer << let_define.first << " : " << let_define.second.first;
-      current_line_length += let_define.first.length() + let_define.second.first.length() + 3;
-
-      // Initialization.
-      if (let_define.second.second.length() > 0) {
-        writer << " <- ";
-        current_line_length += 4;
-        generate_expression(let_define.second.second);
-      }
-
-      // No comma on last iteration.
-      if (i != let_defines.size() - 1) {
-        writer << ", ";
-        current_line_length += 2;
-      }
+    } else {
 
-      identifiers.add_id(let_define.first, let_define.second.first);
+      // Exit scope.
+      identifiers.exit_scope();
+      return false;
     }
-
-    // Print body.
-    writer << " in ";
-    current_line_length += 4;
-    generate_expression(body_type);
   }
-
-  // Exit scope.
-  identifiers.exit_scope();
 }
 
 // EXPRESSION: Case.
-void CodeGenerator::generate_case(string type) {
-
-  // Choose the case expression type.
-  vector<string> possible_case_expr_types = tree.class_names;
-  possible_case_expr_types.push_back("SELF_TYPE");
-  string case_expr_type = possible_case_expr_types[rand() % possible_case_expr_types.size()];
+// NOTES: - Children are the case expression, then each branch.
+//          @frame.types holds their types.
+//        - Step 1 starts child @frame.index (or closes the case) and
+//          step 2 follows it.
+bool ClassGenerator::generate_case(ExpressionFrame& frame) {
+  while (true) {
+    if (frame.step == 0) {
+      ExpressionNode* node = frame.node;
+
+      // Choose the case expression type.
+      frame.types.push_back(random_type());
+
+      // SELF_TYPE is not allowed as a branch identifier type.
+      int num_classes = tree.class_names.size();
+      int max_branches = num_classes < max_case_branches ? num_classes : max_case_branches;
+      int num_branches = rng.below(max_branches - 1) + 1;
+      node->num_bindings = num_branches;
+      node->bindings = arena.make_array<int>(2 * num_branches);
+
+      // A random ordering of the classes gives distinct types: branch i gets
+      // the ith. It is computed per lookup, so only num_branches are drawn.
+      Permutation branch_id_types = Permutation(num_classes, rng);
+
+      // Choose branch signatures (id name, id type and branch type).
+      for (int i = 0; i < num_branches; i++) {
+
+        // No illegal names.
+        vector<string> illegal_names = vector<string>();
+        node->bindings[2 * i] = add_symbol(name_generator.generate(variable, illegal_names, rng));
+        node->bindings[2 * i + 1] = branch_id_types(i);
+
+        // Choose branch type. Must be a child of type.
+        // Expanding to SELF_TYPE means every branch type must be SELF_TYPE.
+        frame.types.push_back(choose_subtype(frame.type));
+      }
+      add_children(frame, num_branches + 1);
+      frame.step = 1;
+
+    } else if (frame.step == 1) {
+      ExpressionNode* node = frame.node;
+      int i = frame.index;
+      if (i == node->num_children) return false;
+
+      // Branches declare their variable in a scope of their own.
+      if (i > 0) {
+        identifiers.enter_scope();
+        identifiers.add_id(symbols[node->bindings[2 * (i - 1)]], tree.class_names[node->bindings[2 * i - 1]]);
+      }
+      frame.step = 2;
+      node->children[i] = push_expression(frame.types[i]);
+      return true;
 
-  // Choose branch types.
-  // Expanding to SELF_TYPE means every branch type must be SELF_TYPE.
-  vector<string> branch_types = vector<string>();
-  if (type == "SELF_TYPE") {
-    branch_types.push_back("SELF_TYPE");
-  } else {
-    set<string> descendants = tree.class_descendants[type];
-    branch_types = vector<string>(descendants.begin(), descendants.end());
-    branch_types.push_back(type);
-    if (tree.is_child_of(current_class, type)) {
-      branch_types.push_back("SELF_TYPE");
+    } else {
+      if (frame.index > 0) identifiers.exit_scope();
+      frame.index++;
+      frame.step = 1;
     }
   }
-
-  // SELF_TYPE is not allowed as a branch identifier type.
-  vector<string> branch_id_types = tree.class_names;
-
-  int max_branches = branch_id_types.size() < max_case_branches ? branch_id_types.size() : max_case_branches;
-  int num_branches = (rand() % (max_branches - 1)) + 1;
-
-  // Permute branch_id_types randomly so we can choose the ith type for branch i.
-  random_shuffle(branch_id_types.begin(), branch_id_types.end());
-
-  // Choose branch signatures ((id name, id type), branch type).
-  vector<pair<pair<string, string>, string> > branch_signatures = vector<pair<pair<string, string>, string> >();
-  for (int i = 0; i < num_branches; i++) {
-
-    // No illegal names.
-    vector<string> illegal_names = vector<string>();
-    string name = name_generator.generate(variable, illegal_names);
-    string id_type = branch_id_types[i];
-    pair<string, string> id_signature = pair<string, string>(name, id_type);
-
-    // Choose branch type. Must be a child of type.
-    string branch_type = branch_types[rand() % branch_types.size()];
-
-    // Update data structure.
-    branch_signatures.push_back(pair<pair<string, string>, string>(id_signature, branch_type));
-  }
-
-  // Print out case header.
-  writer << "case ";
-  current_line_length += 5;
-  generate_expression(case_expr_type);
-  writer << " of" << endl;
-  indentation_tabs++;
-
-  // Print out branches.
-  for (int i = 0; i < num_branches; i++) {
-    print_tabs();
-    string id_name = branch_signatures[i].first.first;
-    string id_type = branch_signatures[i].first.second;
-    writer << id_name << " : ";
-    writer << id_type << " => ";
-    current_line_length += id_name.length() + 7 + id_type.length();
-    identifiers.enter_scope();
-    identifiers.add_id(id_name, id_type);
-    generate_expression(branch_signatures[i].second);
-    identifiers.exit_scope();
-    writer << ";" << endl;
-  }
-
-  indentation_tabs--;
-  print_tabs();
-  writer << "esac";
-  current_line_length += 4;
 }
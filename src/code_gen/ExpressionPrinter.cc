@@ -0,0 +1,513 @@
+// File         : ExpressionPrinter.cc
+// Description  : Prints the expression trees built by ExpressionGenerator.cc.
+
+#include <string>
+#include <vector>
+#include "CodeGenerator.h"
+#include "ClassGenerator.h"
+
+using namespace std;
+
+extern const char* arithmetic_operations[];
+extern const char* comparison_operations[];
+
+// FUNCTION: Prints the expression tree at @root.
+// NOTES: - Like generation, printing runs from a stack of frames instead
+//          of recursing, so deep trees don't need a deep native stack.
+//        - Line lengths are tracked here, and long lines are broken up.
+void ClassGenerator::print_expression(const ExpressionNode* root) {
+  int base = print_frames.size();
+  push_print(root);
+  while (print_frames.size() > base) {
+    if (!print_expansion(print_frames.back())) print_frames.pop_back();
+  }
+}
+
+// FUNCTION: Pushes a frame printing @node.
+void ClassGenerator::push_print(const ExpressionNode* node) {
+  PrintFrame frame;
+  frame.node = node;
+  frame.step = 0;
+  frame.index = 0;
+  frame.wrapped = false;
+  print_frames.push_back(frame);
+}
+
+// FUNCTION: Prints @frame's expression until it pushes a child or is
+// done, and returns whether it pushed one.
+bool ClassGenerator::print_expansion(PrintFrame& frame) {
+  return (this->*expansion_registry[frame.node->expansion].print)(frame);
+}
+
+// EXPRESSION: new.
+bool ClassGenerator::print_new(PrintFrame& frame) {
+  const string& type = tree.type_name(frame.node->type);
+  writer << "new " << type;
+  current_line_length += 4 + type.length();
+  return false;
+}
+
+// EXPRESSION: Bool constant.
+bool ClassGenerator::print_bool(PrintFrame& frame) {
+  if (frame.node->value) {
+    writer << "true";
+    current_line_length += 4;
+  } else {
+    writer << "false";
+    current_line_length += 5;
+  }
+  return false;
+}
+
+// EXPRESSION: String constant.
+bool ClassGenerator::print_string(PrintFrame& frame) {
+  const string& text = symbols[frame.node->value];
+  writer << '\"' << text << '\"';
+  current_line_length += text.length() + 2;
+  return false;
+}
+
+// EXPRESSION: Int constant.
+bool ClassGenerator::print_int(PrintFrame& frame) {
+  string number = to_string(frame.node->value);
+  writer << number;
+  current_line_length += number.length();
+  return false;
+}
+
+// EXPRESSION: Identifier.
+bool ClassGenerator::print_identifier(PrintFrame& frame) {
+  const string& identifier = symbols[frame.node->value];
+  writer << identifier;
+  current_line_length += identifier.length();
+  return false;
+}
+
+// FUNCTION: If the current line is full, starts a new one (indented one
+// more tab if @indent) and returns true.
+bool ClassGenerator::wrap_if_full(bool indent) {
+  if (current_line_length < max_line_length) return false;
+  writer << '\n';
+  if (indent) indentation_tabs++;
+  print_tabs();
+  return true;
+}
+
+// FUNCTION: Ends what wrap_if_full started, if it @wrapped.
+void ClassGenerator::unwrap(bool wrapped, bool indent) {
+  if (!wrapped) return;
+  writer << '\n';
+  if (indent) indentation_tabs--;
+  print_tabs();
+}
+
+// EXPRESSION: Assignment.
+bool ClassGenerator::print_assignment(PrintFrame& frame) {
+  if (frame.step == 0) {
+    const string& identifier = symbols[frame.node->value];
+    writer << identifier << " <- (";
+    current_line_length += identifier.length() + 5;
+    frame.wrapped = wrap_if_full(true);
+    frame.step = 1;
+    push_print(frame.node->children[0]);
+    return true;
+  }
+
+  unwrap(frame.wrapped, true);
+  writer << ")";
+  return false;
+}
+
+// EXPRESSION: Dispatch.
+// NOTES: - Steps: 0 starts the object expression (if any), 1 finishes it,
+//          2 starts the arguments, 3 starts argument @frame.index or
+//          closes the call and 4 finishes that argument.
+//        - Arguments go on lines of their own when there are at least
+//          three or the line is already full.
+bool ClassGenerator::print_dispatch(PrintFrame& frame) {
+  const ExpressionNode* node = frame.node;
+  int num_args = tree.method_arg_starts[node->value + 1] - tree.method_arg_starts[node->value];
+  int first_arg = node->num_children - num_args;
+  while (true) {
+    if (frame.step == 0) {
+      if (node->expansion == SelfDispatch) {
+        frame.step = 2;
+        continue;
+      }
+      writer << '(';
+      current_line_length += 1;
+      frame.wrapped = wrap_if_full(false);
+      frame.step = 1;
+      push_print(node->children[0]);
+      return true;
+
+    } else if (frame.step == 1) {
+      unwrap(frame.wrapped, false);
+      if (node->expansion == StaticDispatch) {
+        const string& static_type = tree.class_names[node->type];
+        writer << ")@" << static_type << '.';
+        current_line_length += 3 + static_type.length();
+      } else {
+        writer << ").";
+        current_line_length += 2;
+      }
+      frame.step = 2;
+
+    } else if (frame.step == 2) {
+      const string& method_name = tree.method_names[node->value];
+      writer << method_name << '(';
+      current_line_length += method_name.length() + 1;
+      frame.wrapped = num_args >= 3 || current_line_length >= max_line_length;
+      if (frame.wrapped) {
+        writer << '\n';
+        indentation_tabs++;
+      }
+      frame.step = 3;
+
+    } else if (frame.step == 3) {
+      if (frame.index == num_args) {
+        if (frame.wrapped) {
+          indentation_tabs--;
+          print_tabs();
+          writer << ')';
+        } else {
+          writer << ')';
+          current_line_length++;
+        }
+        return false;
+      }
+      if (frame.wrapped) print_tabs();
+      frame.step = 4;
+      push_print(node->children[first_arg + frame.index]);
+      return true;
+
+    } else {
+      bool last = frame.index == num_args - 1;
+      if (frame.wrapped) {
+        if (!last) writer << ',';
+        writer << '\n';
+      } else if (!last) {
+        writer << ", ";
+        current_line_length += 2;
+      }
+      frame.index++;
+      frame.step = 3;
+    }
+  }
+}
+
+// EXPRESSION: Conditional.
+bool ClassGenerator::print_conditional(PrintFrame& frame) {
+  const ExpressionNode* node = frame.node;
+  if (frame.step == 0) {
+
+    //    if (bool) {
+    writer << "if (";
+    current_line_length += 4;
+    frame.step = 1;
+    push_print(node->children[0]);
+    return true;
+
+  } else if (frame.step == 1) {
+    writer << ") then (" << '\n';
+
+    //       then_type
+    //    } else {
+    indentation_tabs++;
+    print_tabs();
+    frame.step = 2;
+    push_print(node->children[1]);
+    return true;
+
+  } else if (frame.step == 2) {
+    writer << '\n';
+    indentation_tabs--;
+    print_tabs();
+    writer << ") else (" << '\n';
+
+    //      else_type
+    //    }
+    indentation_tabs++;
+    print_tabs();
+    frame.step = 3;
+    push_print(node->children[2]);
+    return true;
+  }
+
+  writer << '\n';
+  indentation_tabs--;
+  print_tabs();
+  writer << ") fi";
+  current_line_length += 4;
+  return false;
+}
+
+// EXPRESSION: Loop.
+bool ClassGenerator::print_loop(PrintFrame& frame) {
+  const ExpressionNode* node = frame.node;
+  if (frame.step == 0) {
+    writer << "while (";
+    current_line_length += 7;
+    frame.wrapped = wrap_if_full(true);
+    frame.step = 1;
+    push_print(node->children[0]);
+    return true;
+
+  } else if (frame.step == 1) {
+    unwrap(frame.wrapped, true);
+    writer << ") loop (";
+    current_line_length += 8;
+    frame.wrapped = wrap_if_full(true);
+    frame.step = 2;
+    push_print(node->children[1]);
+    return true;
+  }
+
+  unwrap(frame.wrapped, true);
+  writer << ") pool";
+  current_line_length += 6;
+  return false;
+}
+
+// EXPRESSION: Block.
+// NOTES: Step 1 starts line @frame.index (or closes the block) and
+//        step 2 follows it.
+bool ClassGenerator::print_block(PrintFrame& frame) {
+  const ExpressionNode* node = frame.node;
+  while (true) {
+    if (frame.step == 0) {
+      writer << "{" << '\n';
+      indentation_tabs++;
+      frame.step = 1;
+
+    } else if (frame.step == 1) {
+      if (frame.index == node->num_children) {
+        indentation_tabs--;
+        print_tabs();
+        writer << '}';
+        current_line_length++;
+        return false;
+      }
+      print_tabs();
+      frame.step = 2;
+      push_print(node->children[frame.index]);
+      return true;
+
+    } else {
+      writer << ';' << '\n';
+      frame.index++;
+      frame.step = 1;
+    }
+  }
+}
+
+// EXPRESSION: isVoid.
+bool ClassGenerator::print_isvoid(PrintFrame& frame) {
+  if (frame.step == 0) {
+    writer << "isvoid (";
+    current_line_length += 8;
+    frame.wrapped = wrap_if_full(true);
+    frame.step = 1;
+    push_print(frame.node->children[0]);
+    return true;
+  }
+
+  unwrap(frame.wrapped, true);
+  writer << ')';
+  current_line_length++;
+  return false;
+}
+
+// EXPRESSION: Arithmetic.
+bool ClassGenerator::print_arithmetic(PrintFrame& frame) {
+  return print_binary(frame, arithmetic_operations[frame.node->value]);
+}
+
+// EXPRESSION: Comparison.
+bool ClassGenerator::print_comparison(PrintFrame& frame) {
+  return print_binary(frame, comparison_operations[frame.node->value]);
+}
+
+// FUNCTION: Prints arithmetic and comparisons.
+bool ClassGenerator::print_binary(PrintFrame& frame, const char* operation) {
+  if (frame.step == 0) {
+    writer << "(";
+    current_line_length++;
+    frame.step = 1;
+    push_print(frame.node->children[0]);
+    return true;
+
+  } else if (frame.step == 1) {
+    writer << ") " << operation << " (";
+    current_line_length += 4 + string(operation).length();
+    frame.step = 2;
+    push_print(frame.node->children[1]);
+    return true;
+  }
+
+  writer << ")";
+  current_line_length++;
+  return false;
+}
+
+// EXPRESSION: Integer complement.
+bool ClassGenerator::print_int_complement(PrintFrame& frame) {
+  return print_unary(frame, "~(");
+}
+
+// EXPRESSION: Boolean complement.
+bool ClassGenerator::print_bool_complement(PrintFrame& frame) {
+  return print_unary(frame, "not (");
+}
+
+// FUNCTION: Prints integer and boolean complements.
+bool ClassGenerator::print_unary(PrintFrame& frame, const char* prefix) {
+  if (frame.step == 0) {
+    writer << prefix;
+    current_line_length += string(prefix).length();
+    frame.step = 1;
+    push_print(frame.node->children[0]);
+    return true;
+  }
+  writer << ")";
+  current_line_length++;
+  return false;
+}
+
+// EXPRESSION: Let.
+// NOTES: - @frame.wrapped is whether the let is pretty printed over
+//          several lines, which it is when the line is already full
+//          or there are more than two defines.
+//        - Step 1 starts define @frame.index (or the body), step 2
+//          follows it and step 3 follows the body.
+bool ClassGenerator::print_let(PrintFrame& frame) {
+  const ExpressionNode* node = frame.node;
+  int num_defines = node->num_bindings;
+  while (true) {
+    if (frame.step == 0) {
+      frame.wrapped = current_line_length >= max_line_length || num_defines > 2;
+      if (frame.wrapped) {
+
+        // Print let on new line by itself.
+        writer << '\n';
+        indentation_tabs++;
+        print_tabs();
+        writer << "let " << '\n';
+        indentation_tabs++;
+      } else {
+        writer << "let ";
+      }
+      frame.step = 1;
+
+    } else if (frame.step == 1) {
+      int i = frame.index;
+      if (i == num_defines) {
+
+        // Print body.
+        if (frame.wrapped) {
+          indentation_tabs--;
+          print_tabs();
+          writer << "in" << '\n';
+          indentation_tabs++;
+          print_tabs();
+        } else {
+          writer << " in ";
+          current_line_length += 4;
+        }
+        frame.step = 3;
+        push_print(node->children[i]);
+        return true;
+      }
+
+      // Print statements.
+      const string& name = symbols[node->bindings[2 * i]];
+      const string& type = tree.type_name(node->bindings[2 * i + 1]);
+      if (frame.wrapped) print_tabs();
+      writer << name << " : " << type;
+      if (!frame.wrapped) current_line_length += name.length() + type.length() + 3;
+      frame.step = 2;
+
+      // Initialization.
+      if (node->children[i] != NULL) {
+        writer << " <- ";
+        if (frame.wrapped) {
+          current_line_length += name.length() + type.length() + 7;
+        } else {
+          current_line_length += 4;
+        }
+        push_print(node->children[i]);
+        return true;
+      }
+
+    } else if (frame.step == 2) {
+
+      // No comma on last iteration.
+      if (frame.index != num_defines - 1) {
+        if (frame.wrapped) {
+          writer << ',';
+        } else {
+          writer << ", ";
+          current_line_length += 2;
+        }
+      }
+      if (frame.wrapped) writer << '\n';
+      frame.index++;
+      frame.step = 1;
+
+    } else {
+      if (frame.wrapped) {
+        writer << '\n';
+        indentation_tabs -= 2;
+        print_tabs();
+      }
+      return false;
+    }
+  }
+}
+
+// EXPRESSION: Case.
+// NOTES: Step 1 follows the case expression, step 2 starts branch
+//        @frame.index (or closes the case) and step 3 follows it.
+bool ClassGenerator::print_case(PrintFrame& frame) {
+  const ExpressionNode* node = frame.node;
+  while (true) {
+    if (frame.step == 0) {
+      writer << "case ";
+      current_line_length += 5;
+      frame.step = 1;
+      push_print(node->children[0]);
+      return true;
+
+    } else if (frame.step == 1) {
+      writer << " of" << '\n';
+      indentation_tabs++;
+      frame.step = 2;
+
+    } else if (frame.step == 2) {
+      int i = frame.index;
+      if (i == node->num_bindings) {
+        indentation_tabs--;
+        print_tabs();
+        writer << "esac";
+        current_line_length += 4;
+        return false;
+      }
+
+      // Print out branches.
+      print_tabs();
+      const string& id_name = symbols[node->bindings[2 * i]];
+      const string& id_type = tree.class_names[node->bindings[2 * i + 1]];
+      writer << id_name << " : ";
+      writer << id_type << " => ";
+      current_line_length += id_name.length() + 7 + id_type.length();
+      frame.step = 3;
+      push_print(node->children[i + 1]);
+      return true;
+
+    } else {
+      writer << ";" << '\n';
+      frame.index++;
+      frame.step = 2;
+    }
+  }
+}
@@ -2,12 +2,16 @@
 // Description  : Main executable of Crazy Cool.
 
 #include <unistd.h>
+#include <getopt.h>
 #include <string>
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
 #include <stdlib.h>
+#include <stdint.h>
+#include <ctime>
 #include "CodeGenerator.h"
+#include "util.h"
 
 using namespace std;
 
@@ -16,44 +20,93 @@ bool DEBUG = false;
 // FUNCTION: main execution
 int main(int argc, char* argv[]) {
 
-  // Initialization
-  srand(time(NULL));
-
   // Flag parsing.
   int num_classes = 10;
+  int num_threads = 1;
+  uint64_t seed = time(NULL);
   string corpus_name = "";
+  string output_path = "output.cl";
+  bool map_output = false;
+  string stats_path = "";
+  string trace_path = "";
+  bool trace_expressions = false;
+  int max_depth = 5;
+  int max_expressions = 1000000000;
+
+  // Long options, with a value outside the short ones.
+  static const struct option long_options[] = {
+    {"stats", required_argument, 0, 'S'},
+    {"trace", required_argument, 0, 'T'},
+    {"trace-expressions", no_argument, 0, 'E'},
+    {"max-depth", required_argument, 0, 'D'},
+    {"max-expressions", required_argument, 0, 'X'},
+    {0, 0, 0, 0}
+  };
 
   int c;
-  while ((c = getopt (argc, argv, "c:w:")) != -1) {
+  while ((c = getopt_long (argc, argv, "c:w:j:s:o:m", long_options, NULL)) != -1) {
 
     switch(c) {
       case 'c':
-        try {
-          num_classes = stoi(optarg);
-        }
-        catch (const invalid_argument& ia) {
-          cout << "Invalid argument: " << ia.what() << endl;
-        }
-        catch (const std::out_of_range& oor) {
-          cout << "Out of Range error: " << oor.what() << endl;
-        }
+        if (!parse_int("-c", optarg, num_classes)) return 1;
         break;
       case 'w':
         corpus_name = optarg;
         break;
+      case 'o':
+        output_path = optarg;
+        break;
+      case 'm':
+        map_output = true;
+        break;
+      case 'S':
+        stats_path = optarg;
+        break;
+      case 'T':
+        trace_path = optarg;
+        break;
+      case 'E':
+        trace_expressions = true;
+        break;
+      case 'D':
+        if (!parse_int("--max-depth", optarg, max_depth)) return 1;
+        break;
+      case 'X':
+        if (!parse_int("--max-expressions", optarg, max_expressions)) return 1;
+        break;
+      case 's':
+        if (!parse_seed(optarg, seed)) return 1;
+        break;
+      case 'j':
+        if (!parse_int("-j", optarg, num_threads)) return 1;
+        break;
+      default:
+        return 1;  // getopt has printed what is wrong.
     }
   }
 
+  // Messages go to stderr when the program itself goes to stdout.
+  ostream& log = (output_path == "-") ? cerr : cout;
+
   try {
 
     // Main code generation call.
-    CodeGenerator cg(num_classes, corpus_name);
+    log << "Seed: " << seed << endl;
+    CodeGenerator cg(num_classes, corpus_name, num_threads, seed, output_path, map_output, stats_path,
+                     trace_path, trace_expressions, max_depth, max_expressions);
     cg.generate_code();
 
   } catch (string e) {
-    cout << "Error: " << e << endl;
+    log << "Error: " << e << endl;
+    return 1;
   } catch (const char* e) {
-    cout << "Error: " << e << endl;
+    log << "Error: " << e << endl;
+    return 1;
+  } catch (const exception& e) {
+    log << "Error: " << e.what() << endl;
+    return 1;
   }
 
+  return 0;
+
 }
@@ -0,0 +1,72 @@
+// File         : AliasTable.cc
+// Description  : Implementation of the AliasTable class.
+
+#include <vector>
+#include "AliasTable.h"
+
+using namespace std;
+
+// FUNCTION: Constructor.
+AliasTable::AliasTable() {
+  this->probabilities = vector<double>();
+  this->aliases = vector<int>();
+}
+
+// FUNCTION: Constructor. Builds the table with Vose's variant of
+// Walker's method: columns that are under-full are topped up by
+// exactly one over-full column, which becomes their alias.
+AliasTable::AliasTable(const vector<float>& weights) {
+  int n = weights.size();
+  double total = 0;
+  for (int i = 0; i < n; i++) {
+    if (weights[i] < 0) throw "AliasTable weights must be nonnegative.";
+    total += weights[i];
+  }
+  if (n == 0 || total <= 0) {
+    this->probabilities = vector<double>();
+    this->aliases = vector<int>();
+    return;
+  }
+
+  // Scale weights so that the average column is exactly full.
+  this->probabilities = vector<double>(n);
+  this->aliases = vector<int>(n);
+  vector<double> scaled = vector<double>(n);
+  vector<int> small = vector<int>();
+  vector<int> large = vector<int>();
+  for (int i = 0; i < n; i++) {
+    scaled[i] = weights[i] * n / total;
+    if (scaled[i] < 1.0) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  // Pair each under-full column with an over-full one.
+  while (!small.empty() && !large.empty()) {
+    int under = small.back();
+    int over = large.back();
+    small.pop_back();
+    large.pop_back();
+
+    probabilities[under] = scaled[under];
+    aliases[under] = over;
+    scaled[over] = (scaled[over] + scaled[under]) - 1.0;
+    if (scaled[over] < 1.0) {
+      small.push_back(over);
+    } else {
+      large.push_back(over);
+    }
+  }
+
+  // Whatever is left is full up to rounding error.
+  for (int i = 0; i < large.size(); i++) {
+    probabilities[large[i]] = 1.0;
+    aliases[large[i]] = large[i];
+  }
+  for (int i = 0; i < small.size(); i++) {
+    probabilities[small[i]] = 1.0;
+    aliases[small[i]] = small[i];
+  }
+}
@@ -0,0 +1,65 @@
+// File         : AliasTable.h
+// Description  : Header file for the AliasTable class, which draws
+//                from a discrete distribution in constant time.
+
+#ifndef ALIASTABLE_H_
+#define ALIASTABLE_H_
+
+#include <vector>
+
+// CLASS AliasTable
+// ----------------
+// Walker's alias method. Given weights w_0, ..., w_{n-1},
+// the table is built once in O(n) and then each draw of
+// index i with probability w_i / sum(w) costs O(1) and
+// allocates nothing.
+//
+// Usage:
+//    Construct with the weights, then call sample with a
+//    uniform number in [0, 1). Drawing is split into n
+//    equal columns; column i keeps index i with probability
+//    probabilities[i] and otherwise falls through to aliases[i].
+//
+// NOTES: - Weights must be nonnegative. If they sum to zero
+//          (or there are none) the table is empty and sample
+//          must not be called.
+class AliasTable {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Builds an empty table.
+  AliasTable();
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    [Float] weights
+  //            The relative weight of each index.
+  AliasTable(const std::vector<float>& weights);
+
+  // FUNCTION: sample
+  // ----------------
+  // Parameters:
+  //    Double uniform
+  //            A uniformly random number in [0, 1).
+  // Returns:
+  //    An index in [0, size()) drawn proportionally to the weights.
+  int sample(double uniform) const {
+    double scaled = uniform * probabilities.size();
+    int column = (int) scaled;
+    if (column >= probabilities.size()) column = probabilities.size() - 1;
+    return (scaled - column < probabilities[column]) ? column : aliases[column];
+  }
+
+  // FUNCTION: size
+  // --------------
+  // Returns the number of indices the table draws from.
+  int size() const { return probabilities.size(); }
+
+private:
+  std::vector<double> probabilities;
+  std::vector<int> aliases;
+};
+
+#endif
@@ -0,0 +1,65 @@
+// File: AliasTableTest.cc
+// Description: Basic tests for the AliasTable class.
+
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "AliasTable.h"
+
+using namespace std;
+
+// Sweeps [0, 1) on an even grid and returns the fraction of
+// draws that landed on each index.
+vector<double> frequencies(const AliasTable& table, int num_points) {
+	vector<double> counts = vector<double>(table.size(), 0);
+	for (int i = 0; i < num_points; i++) {
+		counts[table.sample((i + 0.5) / num_points)]++;
+	}
+	for (int i = 0; i < counts.size(); i++) {
+		counts[i] /= num_points;
+	}
+	return counts;
+}
+
+int main() {
+
+	// Empty and all-zero tables draw nothing.
+	assert(AliasTable().size() == 0);
+	assert(AliasTable(vector<float>(3, 0.0)).size() == 0);
+
+	// A single weight always wins.
+	AliasTable single = AliasTable(vector<float>(1, 2.5));
+	assert(single.sample(0.0) == 0);
+	assert(single.sample(0.999999) == 0);
+
+	// Uneven weights are matched exactly on a fine grid.
+	float weights_arr[] = {1.5, 0.5, 1.2, 12.3, 0.0, 4.5};
+	vector<float> weights (weights_arr, weights_arr + 6);
+	double total = 0;
+	for (int i = 0; i < weights.size(); i++) total += weights[i];
+
+	AliasTable table = AliasTable(weights);
+	assert(table.size() == 6);
+	vector<double> observed = frequencies(table, 1000000);
+	for (int i = 0; i < weights.size(); i++) {
+		assert(fabs(observed[i] - weights[i] / total) < 1e-4);
+	}
+
+	// Zero weights are never drawn, even at the column edges.
+	for (int i = 0; i < 6; i++) {
+		assert(table.sample(i / 6.0) != 4);
+		assert(table.sample((i + 1) / 6.0 - 1e-12) != 4);
+	}
+
+	// Equal weights map each column to itself.
+	AliasTable uniform = AliasTable(vector<float>(4, 1.0));
+	assert(uniform.sample(0.1) == 0);
+	assert(uniform.sample(0.3) == 1);
+	assert(uniform.sample(0.6) == 2);
+	assert(uniform.sample(0.9) == 3);
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+// File         : Arena.cc
+// Description  : Implementation of the Arena class.
+
+#include <cstddef>
+#include <cstring>
+#include <vector>
+#include "Arena.h"
+
+using namespace std;
+
+// FUNCTION: Constructor.
+Arena::Arena(size_t block_size)
+    : block_size(block_size == 0 ? 1 : block_size)
+    , offset(0)
+    , used_before(0) {}
+
+// FUNCTION: Destructor.
+Arena::~Arena() {
+  for (int i = 0; i < blocks.size(); i++) {
+    delete[] blocks[i];
+  }
+}
+
+// FUNCTION: Adds a block of @size bytes and allocates from it.
+void Arena::add_block(size_t size) {
+  if (!blocks.empty()) used_before += offset;
+  blocks.push_back(new char[size]);
+  block_sizes.push_back(size);
+  offset = 0;
+}
+
+// FUNCTION: Zeroes @bytes of @memory.
+void Arena::clear_memory(void* memory, size_t bytes) {
+  memset(memory, 0, bytes);
+}
+
+// FUNCTION: allocate
+// NOTES: - Blocks come from new char[], so their start is aligned for
+//          any type and only the offset needs rounding up.
+//        - Alignment padding counts as used, once: it is part of offset.
+void* Arena::allocate(size_t bytes, size_t alignment) {
+  size_t start = (offset + alignment - 1) & ~(alignment - 1);
+  if (blocks.empty() || start + bytes > block_sizes.back()) {
+    add_block(bytes > block_size ? bytes : block_size);
+    start = 0;
+  }
+  offset = start + bytes;
+  return blocks.back() + start;
+}
+
+// FUNCTION: reset
+void Arena::reset() {
+  if (blocks.size() > 1) {
+    size_t total = capacity();
+    for (int i = 0; i < blocks.size(); i++) {
+      delete[] blocks[i];
+    }
+    blocks.clear();
+    block_sizes.clear();
+    add_block(total);
+  }
+  offset = 0;
+  used_before = 0;
+}
+
+// FUNCTION: capacity
+size_t Arena::capacity() const {
+  size_t total = 0;
+  for (int i = 0; i < block_sizes.size(); i++) {
+    total += block_sizes[i];
+  }
+  return total;
+}
@@ -0,0 +1,88 @@
+// File         : Arena.h
+// Description  : Header file for the Arena class, a bump allocator
+//                for short-lived data that is freed all at once.
+
+#ifndef ARENA_H_
+#define ARENA_H_
+
+#include <cstddef>
+#include <vector>
+
+// CLASS Arena
+// -----------
+// Hands out memory from large blocks by bumping an offset, and takes
+// it all back at once with reset. Nothing is freed one by one and
+// no destructors run, so it is meant for plain structs and arrays.
+//
+// Usage:
+//    Allocate with make or make_array while building something,
+//    then reset once it is no longer needed.
+//
+// NOTES: - reset keeps the memory: if the last round took several
+//          blocks, they are merged into one block of their total size,
+//          so a steady workload ends up reusing a single block.
+//        - Requests larger than the block size get a block of their own.
+class Arena {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    Size block_size
+  //        The size of the blocks memory is taken from.
+  Arena(size_t block_size = 1 << 16);
+  ~Arena();
+
+  // FUNCTION: allocate
+  // ------------------
+  // Returns @bytes of uninitialized memory aligned to @alignment
+  // (a power of two, at most that of std::max_align_t).
+  void* allocate(size_t bytes, size_t alignment);
+
+  // FUNCTION: make
+  // --------------
+  // Returns a zeroed T. T must be trivially copyable.
+  template <typename T>
+  T* make() { return make_array<T>(1); }
+
+  // FUNCTION: make_array
+  // --------------------
+  // Returns @count zeroed Ts. T must be trivially copyable.
+  template <typename T>
+  T* make_array(size_t count) {
+    T* array = static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    clear_memory(array, count * sizeof(T));
+    return array;
+  }
+
+  // FUNCTION: reset
+  // ---------------
+  // Takes back everything allocated so far.
+  void reset();
+
+  // FUNCTION: bytes_used
+  // --------------------
+  // Returns the bytes handed out since the last reset.
+  size_t bytes_used() const { return used_before + offset; }
+
+  // FUNCTION: capacity
+  // ------------------
+  // Returns the bytes held in blocks.
+  size_t capacity() const;
+
+private:
+  void add_block(size_t size);
+  static void clear_memory(void* memory, size_t bytes);
+
+  size_t block_size;
+  std::vector<char*> blocks;
+  std::vector<size_t> block_sizes;
+  size_t offset;        // Into the last block.
+  size_t used_before;   // Bytes handed out from earlier blocks.
+
+  // Not copyable: blocks would be freed twice.
+  Arena(const Arena&);
+  Arena& operator=(const Arena&);
+};
+
+#endif
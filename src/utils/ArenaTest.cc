@@ -0,0 +1,75 @@
+// File: ArenaTest.cc
+// Description: Basic tests for the Arena class.
+
+#include <cassert>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+#include "Arena.h"
+
+using namespace std;
+
+struct Node {
+	int value;
+	Node* next;
+};
+
+int main() {
+
+	// Bytes used include alignment padding once, and a block that was
+	// left for a new one counts for what was handed out from it.
+	Arena counted(256);
+	counted.make_array<char>(1);
+	assert(counted.bytes_used() == 1);
+	counted.make<long long>();
+	assert(counted.bytes_used() == 16);
+	counted.make_array<char>(300);
+	assert(counted.bytes_used() == 316);
+	counted.make<int>();
+	assert(counted.bytes_used() == 320);
+	assert(counted.capacity() == 256 + 300 + 256);
+	counted.reset();
+	assert(counted.bytes_used() == 0);
+
+	// Allocations are zeroed, aligned and don't overlap.
+	Arena arena(256);
+	vector<Node*> nodes = vector<Node*>();
+	for (int i = 0; i < 100; i++) {
+		char* padding = arena.make_array<char>(i % 7);
+		Node* node = arena.make<Node>();
+		assert(node->value == 0 && node->next == NULL);
+		assert((uintptr_t) node % alignof(Node) == 0);
+		node->value = i;
+		node->next = nodes.empty() ? NULL : nodes.back();
+		if (i % 7 != 0) padding[i % 7 - 1] = 'x';
+		nodes.push_back(node);
+	}
+	for (int i = 0; i < 100; i++) {
+		assert(nodes[i]->value == i);
+	}
+	assert(arena.bytes_used() >= 100 * sizeof(Node));
+	assert(arena.capacity() > 256);
+
+	// Requests larger than a block get their own.
+	int* big = arena.make_array<int>(1000);
+	big[999] = 1;
+	assert(nodes[99]->value == 99);
+
+	// Reset merges the blocks, and the same workload then fits in one.
+	size_t capacity = arena.capacity();
+	arena.reset();
+	assert(arena.bytes_used() == 0);
+	assert(arena.capacity() == capacity);
+	for (int i = 0; i < 100; i++) {
+		arena.make_array<char>(i % 7);
+		arena.make<Node>();
+	}
+	arena.make_array<int>(1000);
+	assert(arena.capacity() == capacity);
+	arena.reset();
+	assert(arena.capacity() == capacity);
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
@@ -0,0 +1,87 @@
+// File         : Keywords.h
+// Description  : The reserved words that generated names must avoid,
+//                as constant tables that are checked without allocating.
+
+#ifndef KEYWORDS_H_
+#define KEYWORDS_H_
+
+// FUNCTION fold_case
+// ------------------
+// Returns @c in lowercase if it is an ASCII capital and unchanged
+// otherwise. c - 'A' is below 26 as an unsigned number exactly for
+// capitals, and that comparison supplies the 0x20 bit, so there
+// is no branch.
+constexpr char fold_case(char c) {
+  return (char) (c | (((unsigned) (c - 'A') < 26u) << 5));
+}
+
+// ENUM KeywordSet
+// ---------------
+// The sets a reserved word can belong to, as bits.
+//    CLASS_KEYWORD   : not allowed as a class name (keywords and basic classes)
+//    FEATURE_KEYWORD : not allowed as a feature or variable name (keywords,
+//                      true, false and self)
+enum KeywordSet { CLASS_KEYWORD = 1, FEATURE_KEYWORD = 2 };
+
+// STRUCT Keyword
+// --------------
+// One reserved word, in lowercase.
+struct Keyword {
+  const char* word;
+  int length;
+  int sets;
+};
+
+// FUNCTION keyword_hash
+// ---------------------
+// Hashes the @length characters at @name, ignoring case, to a slot of
+// keyword_table. Every reserved word gets its own slot.
+constexpr int keyword_hash(const char* name, int length) {
+  return (fold_case(name[0]) + 31 * fold_case(name[length - 1]) + 7 * length) & 63;
+}
+
+// Every reserved word, stored in the slot it hashes to.
+constexpr int BOTH_KEYWORD = CLASS_KEYWORD | FEATURE_KEYWORD;
+constexpr Keyword keyword_table[64] = {
+  {"", 0, 0}, {"", 0, 0}, {"", 0, 0}, {"", 0, 0},
+  {"false", 5, FEATURE_KEYWORD}, {"", 0, 0}, {"", 0, 0}, {"", 0, 0},
+  {"", 0, 0}, {"in", 2, BOTH_KEYWORD}, {"int", 3, CLASS_KEYWORD}, {"true", 4, FEATURE_KEYWORD},
+  {"", 0, 0}, {"let", 3, BOTH_KEYWORD}, {"inherits", 8, BOTH_KEYWORD}, {"not", 3, BOTH_KEYWORD},
+  {"", 0, 0}, {"if", 2, BOTH_KEYWORD}, {"bool", 4, CLASS_KEYWORD}, {"", 0, 0},
+  {"", 0, 0}, {"while", 5, BOTH_KEYWORD}, {"string", 6, CLASS_KEYWORD}, {"of", 2, BOTH_KEYWORD},
+  {"loop", 4, BOTH_KEYWORD}, {"", 0, 0}, {"", 0, 0}, {"main", 4, CLASS_KEYWORD},
+  {"", 0, 0}, {"", 0, 0}, {"", 0, 0}, {"", 0, 0},
+  {"pool", 4, BOTH_KEYWORD}, {"", 0, 0}, {"then", 4, BOTH_KEYWORD}, {"", 0, 0},
+  {"", 0, 0}, {"object", 6, CLASS_KEYWORD}, {"", 0, 0}, {"", 0, 0},
+  {"io", 2, CLASS_KEYWORD}, {"self", 4, FEATURE_KEYWORD}, {"", 0, 0}, {"fi", 2, BOTH_KEYWORD},
+  {"new", 3, BOTH_KEYWORD}, {"self_type", 9, CLASS_KEYWORD}, {"", 0, 0}, {"isvoid", 6, BOTH_KEYWORD},
+  {"", 0, 0}, {"", 0, 0}, {"", 0, 0}, {"class", 5, BOTH_KEYWORD},
+  {"", 0, 0}, {"", 0, 0}, {"", 0, 0}, {"", 0, 0},
+  {"", 0, 0}, {"", 0, 0}, {"case", 4, BOTH_KEYWORD}, {"", 0, 0},
+  {"else", 4, BOTH_KEYWORD}, {"", 0, 0}, {"esac", 4, BOTH_KEYWORD}, {"", 0, 0}
+};
+
+// Checks at compile time that every word sits in its own slot.
+constexpr bool keyword_table_is_perfect(int slot) {
+  return slot == 64 ||
+         ((keyword_table[slot].length == 0 ||
+           keyword_hash(keyword_table[slot].word, keyword_table[slot].length) == slot) &&
+          keyword_table_is_perfect(slot + 1));
+}
+static_assert(keyword_table_is_perfect(0), "A keyword is not in the slot it hashes to");
+
+// FUNCTION keyword_sets
+// ---------------------
+// Returns the KeywordSet bits of the @length characters at @name,
+// ignoring case; 0 if they aren't a reserved word.
+inline int keyword_sets(const char* name, int length) {
+  if (length < 2 || length > 9) return 0;
+  const Keyword& keyword = keyword_table[keyword_hash(name, length)];
+  if (keyword.length != length) return 0;
+  for (int i = 0; i < length; i++) {
+    if (fold_case(name[i]) != keyword.word[i]) return 0;
+  }
+  return keyword.sets;
+}
+
+#endif
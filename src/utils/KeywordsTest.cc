@@ -0,0 +1,59 @@
+// File: KeywordsTest.cc
+// Description: Basic tests for the keyword tables.
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include "Keywords.h"
+
+using namespace std;
+
+int sets_of(string name) {
+	return keyword_sets(name.data(), name.length());
+}
+
+int main() {
+
+	// Case folding only touches capitals.
+	for (int c = -128; c < 128; c++) {
+		char folded = fold_case((char) c);
+		if (c >= 'A' && c <= 'Z') assert(folded == c - 'A' + 'a');
+		else assert(folded == c);
+	}
+
+	// Every reserved word is found, in any case, in the right sets.
+	string class_keywords[] = {"class", "else", "fi", "if", "in",
+	                           "inherits", "isvoid", "let", "loop", "pool",
+	                           "then", "while", "case", "esac", "new",
+	                           "of", "not", "object", "io", "int",
+	                           "string", "bool", "main", "self_type"};
+	string feature_keywords[] = {"class", "else", "fi", "if", "in",
+	                             "inherits", "isvoid", "let", "loop", "pool",
+	                             "then", "while", "case", "esac", "new",
+	                             "of", "not", "true", "false", "self"};
+	for (int i = 0; i < 24; i++) {
+		assert(sets_of(class_keywords[i]) & CLASS_KEYWORD);
+	}
+	for (int i = 0; i < 20; i++) {
+		assert(sets_of(feature_keywords[i]) & FEATURE_KEYWORD);
+	}
+	assert(sets_of("Class") == (CLASS_KEYWORD | FEATURE_KEYWORD));
+	assert(sets_of("SELF_TYPE") == CLASS_KEYWORD);
+	assert(sets_of("Main") == CLASS_KEYWORD);
+	assert(sets_of("TRUE") == FEATURE_KEYWORD);
+	assert(sets_of("self") == FEATURE_KEYWORD);
+
+	// Anything else isn't.
+	assert(sets_of("") == 0);
+	assert(sets_of("c") == 0);
+	assert(sets_of("classes") == 0);
+	assert(sets_of("clasS_") == 0);
+	assert(sets_of("self_typ") == 0);
+	assert(sets_of("self_types") == 0);
+	assert(sets_of("esca") == 0);
+	assert(sets_of("Inherits1") == 0);
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
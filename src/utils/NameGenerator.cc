@@ -4,10 +4,18 @@
 #include <string>
 #include <stdlib.h>
 #include <unistd.h>
-#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cerrno>
+#include <cstring>
 #include <iostream>
 #include <vector>
 #include <cctype>
+#include "Keywords.h"
+#include "NameRegistry.h"
+#include "Permutation.h"
+#include "Random.h"
 #include "util.h"
 #include "NameGenerator.h"
 
@@ -19,20 +27,43 @@ using namespace std;
 // NOTE: We keep the alphabetic characters at the front so we can iterate over the alphabet easily.
 static const char valid_characters[NUM_VALID_CHARACTERS + 1] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789_";
 
-// Disallowed class keywords.
-string class_keywords[] = {"class", "else", "fi", "if", "in",
-                            "inherits", "isvoid", "let", "loop", "pool",
-                            "then", "while", "case", "esac", "new",
-                            "of", "not", "object", "io", "int",
-                            "string", "bool", "main", "self_type"};
-vector<string> class_keyword_vec (class_keywords, class_keywords + 24);
-
-// Disallowed feature keywords.
-string feature_keywords[] = {"class", "else", "fi", "if", "in",
-                                "inherits", "isvoid", "let", "loop", "pool",
-                                "then", "while", "case", "esac", "new",
-                                "of", "not", "true", "false", "self"};
-vector<string> feature_keyword_vec (feature_keywords, feature_keywords + 20);
+// Character tables for the corpus, indexed by unsigned char.
+//    classes : SPACE for separators (as isspace), LETTER for letters
+//              and WORD for everything allowed in a name
+//    upper   : the character in uppercase
+enum CharacterClass { SPACE = 1, LETTER = 2, WORD = 4 };
+struct CharacterTables {
+  unsigned char classes[256];
+  char upper[256];
+
+  CharacterTables() {
+    for (int c = 0; c < 256; c++) {
+      classes[c] = 0;
+      upper[c] = (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c;
+    }
+    for (int j = 0; j < NUM_VALID_CHARACTERS; j++) {
+      classes[(unsigned char) valid_characters[j]] = (j < 26 * 2) ? LETTER | WORD : WORD;
+    }
+    const char* spaces = " \t\n\v\f\r";
+    for (int j = 0; spaces[j] != '\0'; j++) {
+      classes[(unsigned char) spaces[j]] = SPACE;
+    }
+  }
+};
+static const CharacterTables tables;
+
+// FUNCTION: Returns true if @words contains the @length characters
+// at @name, ignoring case.
+static bool contains_ignoring_case(const vector<string>& words, const char* name, int length) {
+  for (int i = 0; i < words.size(); i++) {
+    const string& word = words[i];
+    if (word.length() != length) continue;
+    int j = 0;
+    while (j < length && fold_case(word[j]) == fold_case(name[j])) j++;
+    if (j == length) return true;
+  }
+  return false;
+}
 
 // FUNCTION: Constructor. Also caches the corpus.
 NameGenerator::NameGenerator( string corpus_path,
@@ -40,7 +71,8 @@ NameGenerator::NameGenerator( string corpus_path,
                               int attribute_name_length,
                               int method_name_length,
                               int method_arg_name_length,
-                              int variable_name_length) {
+                              int variable_name_length)
+                              : rejected_names(0) {
 
   // If we are supplied a corpus, parse
   // the absolute path and cache it.
@@ -68,41 +100,74 @@ NameGenerator::NameGenerator( string corpus_path,
 }
 
 // FUNCTION: Generates a random alphanumeric string.
-string NameGenerator::generate_random_string(int length) {
+string NameGenerator::generate_random_string(int length, Random& rng) const {
   string str = "";
   for(int i = 0; i < length; i++) {
-    str += valid_characters[rand() % 63];
+    str += valid_characters[rng.below(63)];
   }
   return str;
 }
 
 // FUNCTION: Generates a COOL name that is not contained in @illegal_names.
 // The supported types are given by the enum NameTypes defined in the header.
-string NameGenerator::generate(NameType type, vector<string> illegal_names) const {
+string NameGenerator::generate(NameType type, const vector<string>& illegal_names, Random& rng) const {
+  return generate_name(type, illegal_names, rng);
+}
+
+// FUNCTION: Generates a COOL name that is not in @reserved_names and adds it.
+string NameGenerator::generate(NameType type, NameRegistry& reserved_names, Random& rng) const {
+  string name = generate_name(type, reserved_names, rng);
+  reserved_names.insert(name);
+  return name;
+}
+
+// FUNCTION: Returns true if the @length characters at @name are
+// in @illegal_words, ignoring case.
+static bool is_illegal(const vector<string>& illegal_words, const char* name, int length) {
+  return contains_ignoring_case(illegal_words, name, length);
+}
+static bool is_illegal(const NameRegistry& illegal_words, const char* name, int length) {
+  return illegal_words.contains(name, length);
+}
+
+// FUNCTION: Returns @name with the first suffix _1, _2, ... that is not
+// in @illegal_words. Suffixed names are never keywords.
+template <class Names>
+static string add_free_suffix(const string& name, const Names& illegal_words) {
+  for (long long round = 1; ; round++) {
+    string suffixed = name + "_" + to_string(round);
+    if (!is_illegal(illegal_words, suffixed.data(), suffixed.length())) return suffixed;
+  }
+}
+
+// FUNCTION: Generates a COOL name of @type that is not in @illegal_words.
+template <class Names>
+string NameGenerator::generate_name(NameType type, const Names& illegal_words, Random& rng) const {
 
   // Corpus extraction.
   if (corpus_path.length() > 0) {
     if (type == className) {
-      return extract_class_name(illegal_names);
+      return extract_class_name(illegal_words, rng);
     }
-    return extract_feature_name(illegal_names);
+    return extract_feature_name(illegal_words, rng);
   }
 
   // Random generation.
   if (type == className) {
-    return generate_random_class_name(class_name_length, illegal_names);
+    return generate_random_class_name(class_name_length, illegal_words, rng);
   } else if (type == attribute) {
-    return generate_random_feature_name(attribute_name_length, illegal_names);
+    return generate_random_feature_name(attribute_name_length, illegal_words, rng);
   } else if (type == method) {
-    return generate_random_feature_name(method_name_length, illegal_names);
+    return generate_random_feature_name(method_name_length, illegal_words, rng);
   } else if (type == variable) {
-    return generate_random_feature_name(variable_name_length, illegal_names);
+    return generate_random_feature_name(variable_name_length, illegal_words, rng);
   }
-  return generate_random_feature_name(method_arg_name_length, illegal_names);
+  return generate_random_feature_name(method_arg_name_length, illegal_words, rng);
 }
 
 // FUNCTION: Generates a random COOL class name of the desired length.
-string NameGenerator::generate_random_class_name(int length, vector<string> illegal_words) const {
+template <class Names>
+string NameGenerator::generate_random_class_name(int length, const Names& illegal_words, Random& rng) const {
   if (length <= 0) throw "Nonpositive name length";
   string class_name = "";
 
@@ -110,31 +175,34 @@ string NameGenerator::generate_random_class_name(int length, vector<string> ille
 
   while (true) {
     // Generate first character uppercase.
-    char first = valid_characters[rand() % 26];
+    char first = valid_characters[rng.below(26)];
     class_name += first;
 
     // Generate rest of class name.
     for (int i = 0; i < length - 1; i++) {
-      char c = valid_characters[rand() % 63];
+      char c = valid_characters[rng.below(63)];
       class_name += c;
     }
 
     // Exit if class name is not a keyword and not in list of illegal words.
-    if (!(string_vector_contains(class_name, class_keyword_vec) ||
-                  string_vector_contains(class_name, illegal_words))) break;
+    if (!((keyword_sets(class_name.data(), class_name.length()) & CLASS_KEYWORD) ||
+                  is_illegal(illegal_words, class_name.data(), class_name.length()))) break;
 
-    // Throw exception on max iterations limit.
+    // Past the iterations limit, number the last candidate instead.
     iterations++;
+    rejected_names.fetch_add(1, memory_order_relaxed);
     if (iterations > 100) {
-      throw "Reached max iteration limit while generating class name.";
+      return add_free_suffix(class_name, illegal_words);
     }
+    class_name = "";
   }
 
   return class_name;
 }
 
 // FUNCTION: Generates a random COOL feature name of the desired length.
-string NameGenerator::generate_random_feature_name(int length, vector<string> illegal_words) const {
+template <class Names>
+string NameGenerator::generate_random_feature_name(int length, const Names& illegal_words, Random& rng) const {
   if (length <= 0) throw "Nonpositive name length";
   string feature_name = "";
 
@@ -142,117 +210,217 @@ string NameGenerator::generate_random_feature_name(int length, vector<string> il
 
   while (true) {
     // Generate first character lowercase.
-    char first = valid_characters[(rand() % 26) + 26];
+    char first = valid_characters[rng.below(26) + 26];
     feature_name += first;
 
     // Generate rest of class name.
     for (int i = 0; i < length - 1; i++) {
-      char c = valid_characters[rand() % 63];
+      char c = valid_characters[rng.below(63)];
       feature_name += c;
     }
 
     // Exit if class name is not a keyword and not in list of illegal words.
-    if (!(string_vector_contains(feature_name, feature_keyword_vec) ||
-                  string_vector_contains(feature_name, illegal_words))) break;
+    if (!((keyword_sets(feature_name.data(), feature_name.length()) & FEATURE_KEYWORD) ||
+                  is_illegal(illegal_words, feature_name.data(), feature_name.length()))) break;
 
-    // Throw exception on max iterations limit.
+    // Past the iterations limit, number the last candidate instead.
     iterations++;
+    rejected_names.fetch_add(1, memory_order_relaxed);
     if (iterations > 100) {
-      throw "Reached max iteration limit while generating feature name.";
+      return add_free_suffix(feature_name, illegal_words);
     }
+    feature_name = "";
   }
 
   return feature_name;
 }
 
 // FUNCTION: Caches the corpus into the corpus class member variable.
+// NOTES: - The file is mapped rather than read, and split into words
+//          on whitespace with the character table.
 void NameGenerator::cache_corpus() {
-  ifstream file(corpus_path);
-  string word;
-  while(file >> word) {
-    if (!validate_name(word)) {
-      throw "Invalid word in corpus: " + word;
+  int fd = open(corpus_path.c_str(), O_RDONLY);
+  if (fd == -1) {
+    throw "Could not open corpus " + corpus_path + ": " + strerror(errno);
+  }
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    throw "Could not read corpus " + corpus_path + ": " + strerror(errno);
+  }
+  size_t size = info.st_size;
+  void* mapping = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    throw "Could not map corpus " + corpus_path + ": " + strerror(errno);
+  }
+  if (size > 0) madvise(mapping, size, MADV_SEQUENTIAL);
+
+  const char* text = (const char*) mapping;
+  corpus_names.reserve(2 * size);
+  try {
+    size_t i = 0;
+    while (i < size) {
+      while (i < size && (tables.classes[(unsigned char) text[i]] & SPACE)) i++;
+      size_t begin = i;
+      while (i < size && !(tables.classes[(unsigned char) text[i]] & SPACE)) i++;
+      if (i > begin) add_corpus_word(text + begin, i - begin);
     }
-    corpus.push_back(word);
+  } catch (...) {
+    munmap(mapping, size);
+    throw;
+  }
+  if (size > 0) munmap(mapping, size);
+
+  if (corpus.size() == 0) {
+    throw "Empty corpus " + corpus_path;
   }
 }
 
-// FUNCTION: Extracts a COOL class name from the corpus.
-string NameGenerator::extract_class_name(vector<string> illegal_words) const {
+// FUNCTION: Validates the @length characters at @word and adds
+// them to the corpus in both cases.
+void NameGenerator::add_corpus_word(const char* word, int length) {
+  if (!validate_name(word, length)) {
+    throw "Invalid word in corpus: " + string(word, length);
+  }
 
-  string class_name = "";
+  CorpusWord entry;
+  entry.offset = corpus_names.size();
+  entry.length = length;
+  for (int i = 0; i < length; i++) {
+    corpus_names.push_back(fold_case(word[i]));
+  }
+  corpus_names.push_back(tables.upper[(unsigned char) word[0]]);
+  for (int i = 1; i < length; i++) {
+    corpus_names.push_back(fold_case(word[i]));
+  }
+  entry.keywords = keyword_sets(word, length);
+  corpus.push_back(entry);
+}
+
+// FUNCTION: Extracts a COOL class name from the corpus.
+template <class Names>
+string NameGenerator::extract_class_name(const Names& illegal_words, Random& rng) const {
   int iterations = 0;
 
   while(true) {
-    class_name = corpus[rand() % corpus.size()];
-    if (class_name.length() == 0) continue;
-
-    // Change capitalization.
-    class_name[0] = toupper(class_name[0]);
-    for (int i = 1; i < class_name.length(); i++) {
-      class_name[i] = tolower(class_name[i]);
-    }
+    const CorpusWord& word = corpus[rng.below(corpus.size())];
+    const char* class_name = &corpus_names[word.offset + word.length];
 
     // Exit if class name is not a keyword and not in list of illegal words.
-    if (!(string_vector_contains(class_name, class_keyword_vec) ||
-                  string_vector_contains(class_name, illegal_words))) break;
+    if (!((word.keywords & CLASS_KEYWORD) ||
+          is_illegal(illegal_words, class_name, word.length))) {
+      return string(class_name, word.length);
+    }
 
-    // Throw exception on max iterations limit.
+    // Past the iterations limit, number the last candidate instead.
     iterations++;
+    rejected_names.fetch_add(1, memory_order_relaxed);
     if (iterations > 100) {
-      throw "Reached max iteration limit while extracting class name. Expand your corpus!";
+      return add_free_suffix(string(class_name, word.length), illegal_words);
     }
   }
-
-  return class_name;
 }
 
 // FUNCTION: Extracts a COOL feature name from the corpus.
-string NameGenerator::extract_feature_name(vector<string> illegal_words) const {
-  string feature_name = "";
+template <class Names>
+string NameGenerator::extract_feature_name(const Names& illegal_words, Random& rng) const {
   int iterations = 0;
 
   while(true) {
-    feature_name = corpus[rand() % corpus.size()];
-    if (feature_name.length() == 0) continue;
+    const CorpusWord& word = corpus[rng.below(corpus.size())];
+    const char* feature_name = &corpus_names[word.offset];
 
-    // Change capitalization.
-    for (int i = 0; i < feature_name.length(); i++) {
-      feature_name[i] = tolower(feature_name[i]);
+    // Exit if feature name is not a keyword and not in list of illegal words.
+    if (!((word.keywords & FEATURE_KEYWORD) ||
+          is_illegal(illegal_words, feature_name, word.length))) {
+      return string(feature_name, word.length);
     }
 
-    // Exit if class name is not a keyword and not in list of illegal words.
-    if (!(string_vector_contains(feature_name, feature_keyword_vec) ||
-                  string_vector_contains(feature_name, illegal_words))) break;
-
-    // Throw exception on max iterations limit.
+    // Past the iterations limit, number the last candidate instead.
     iterations++;
+    rejected_names.fetch_add(1, memory_order_relaxed);
     if (iterations > 100) {
-      throw "Reached max iteration limit while extracting feature name. Expand your corpus!";
+      return add_free_suffix(string(feature_name, word.length), illegal_words);
     }
   }
-
-  return feature_name;
 }
 
 // FUNCTION: Validates that a name contains only alphanumeric
 //           characters + underscores and that the first letter
 //           is alphabetic.
-bool NameGenerator::validate_name(string name) {
-  for (int i = 0; i < name.length(); i++) {
-    char character = name[i];
-    bool flag = false;
-    for (int j = 0; j < NUM_VALID_CHARACTERS; j++) {
+bool NameGenerator::validate_name(const char* name, int length) const {
+  if (length == 0) return true;
+  if (!(tables.classes[(unsigned char) name[0]] & LETTER)) return false;
+  for (int i = 1; i < length; i++) {
+    if (!(tables.classes[(unsigned char) name[i]] & WORD)) return false;
+  }
+  return true;
+}
+
+// FUNCTION: Returns the configured length of random names of @type.
+int NameGenerator::name_length(NameType type) const {
+  if (type == className) return class_name_length;
+  if (type == attribute) return attribute_name_length;
+  if (type == method) return method_name_length;
+  if (type == variable) return variable_name_length;
+  return method_arg_name_length;
+}
 
-      // First character must be a letter.
-      if (i == 0 && j == 26 * 2) break;
+// FUNCTION: Returns the number of names of @type, capped at 2^62.
+uint64_t NameGenerator::name_space_size(NameType type) const {
+  if (corpus_path.length() > 0) return corpus.size();
 
-      char valid_character = valid_characters[j];
-      if (character == valid_character) {
-        flag = true;
-      }
-    }
-    if (!flag) return false;
+  int length = name_length(type);
+  if (length <= 0) throw "Nonpositive name length";
+  uint64_t cap = 1ULL << 62;
+  uint64_t size = 26;
+  for (int i = 1; i < length && size < cap; i++) {
+    size = (size > cap / 63) ? cap : size * 63;
+  }
+  return size;
+}
+
+// FUNCTION: Returns name number @index of @type: a corpus word, or the
+// digits of @index in the alphabet of valid characters, least
+// significant first (and the first one a letter).
+string NameGenerator::name_at(NameType type, uint64_t index) const {
+  if (corpus_path.length() > 0) {
+    const CorpusWord& word = corpus[index];
+    size_t offset = (type == className) ? word.offset + word.length : word.offset;
+    return string(&corpus_names[offset], word.length);
+  }
+
+  int length = name_length(type);
+  string name = string(length, ' ');
+  name[0] = valid_characters[index % 26 + (type == className ? 0 : 26)];
+  index /= 26;
+  for (int i = 1; i < length; i++) {
+    name[i] = valid_characters[index % 63];
+    index /= 63;
+  }
+  return name;
+}
+
+// FUNCTION: Constructor.
+NameAllocator::NameAllocator(const NameGenerator& generator, NameType type, Random& rng)
+    : generator(generator)
+    , type(type)
+    , order(generator.name_space_size(type), rng)
+    , count(0) {}
+
+// FUNCTION: next
+string NameAllocator::next(NameRegistry& reserved_names) {
+  int keyword_set = (type == className) ? CLASS_KEYWORD : FEATURE_KEYWORD;
+  while (true) {
+    uint64_t round = count / order.size();
+    string name = generator.name_at(type, order(count % order.size()));
+    count++;
+    if (round > 0) name += "_" + to_string(round);
+
+    if (keyword_sets(name.data(), name.length()) & keyword_set) continue;
+    if (reserved_names.contains(name)) continue;
+    reserved_names.insert(name);
+    return name;
   }
-  return true;
 }
@@ -5,9 +5,13 @@
 #ifndef NAMEGENERATOR_H_
 #define NAMEGENERATOR_H_
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <stdlib.h>
+#include "NameRegistry.h"
+#include "Permutation.h"
+#include "Random.h"
 
 // ENUM NameType
 // -------------
@@ -42,11 +46,11 @@ enum NameType { className, attribute, method, methodArgument, variable};
 //    numbers, or underscores and that the first letter is always a
 //    letter. If this is not the case, an exception will be thrown.
 //
-// NOTES: - An exception will also be thrown if we loop generate/drawn
-//          more than 100 words from the corpus without finding one that
-//          is both not a disallowed keyword and not inside the list of
-//          illegal words. If this occurs, consider either making your
-//          corpus bigger or using a larger length.
+// NOTES: - If 100 names in a row are drawn that are disallowed keywords
+//          or in the list of illegal words, the last one gets a suffix
+//          instead: name_1, or name_2 if that is taken too, and so on.
+//          So a small corpus or a short length gives suffixed names
+//          rather than an error.
 //
 //        - This does not generate any of the basic classes (Object, IO,
 //          Int, String, Bool) and it won't generate the Main class. However,
@@ -98,9 +102,28 @@ public:
   //              fill this with other class names that the NameGenerator
   //              instance is not aware of so as to ensure
   //              none of those names are chosen/generated.
+  //        Random rng
+  //              The source of randomness for this name.
   // Returns:
   //        A string representing the generated/chosen name.
-  std::string generate(NameType type, std::vector<std::string> illegal_names) const;
+  std::string generate(NameType type, const std::vector<std::string>& illegal_names, Random& rng) const;
+
+  // FUNCTION generate.
+  // ------------------
+  // As above, but checks candidates against a registry in
+  // O(1) each instead of scanning a list.
+  //
+  // Parameters:
+  //        NameType type
+  //              The type of the name to generate.
+  //        NameRegistry reserved_names
+  //              The names that are taken. The generated name
+  //              is added to it.
+  //        Random rng
+  //              The source of randomness for this name.
+  // Returns:
+  //        A string representing the generated/chosen name.
+  std::string generate(NameType type, NameRegistry& reserved_names, Random& rng) const;
 
   // FUNCTION generate_random_string.
   // --------------------------------
@@ -109,23 +132,57 @@ public:
   // Parameters:
   //      Int length
   //            The length of the string to generate. Must be > 0.
+  //      Random rng
+  //            The source of randomness for this string.
   // Returns:
   //      The randomly generated string.
-  std::string generate_random_string(int length);
+  std::string generate_random_string(int length, Random& rng) const;
+
+  // FUNCTION names_rejected.
+  // -------------------------
+  // Returns the number of candidate names generate has drawn
+  // and thrown away (keywords or illegal names) so far, over
+  // every thread.
+  long long names_rejected() const { return rejected_names.load(std::memory_order_relaxed); }
 
 private:
+  friend class NameAllocator;
 
   // Internal functions.
-  bool validate_name(std::string name);
-  std::string generate_random_class_name(int len, std::vector<std::string> illegal_words = std::vector<std::string>()) const;
-  std::string generate_random_feature_name(int len, std::vector<std::string> illegal_words = std::vector<std::string>()) const;
-  std::string extract_class_name(std::vector<std::string> illegal_words) const;
-  std::string extract_feature_name(std::vector<std::string> illegal_words) const;
+  bool validate_name(const char* name, int length) const;
+  uint64_t name_space_size(NameType type) const;
+  std::string name_at(NameType type, uint64_t index) const;
+  int name_length(NameType type) const;
+  // NOTE: These take either a list or a registry of illegal words.
+  template <class Names>
+  std::string generate_name(NameType type, const Names& illegal_words, Random& rng) const;
+  template <class Names>
+  std::string generate_random_class_name(int len, const Names& illegal_words, Random& rng) const;
+  template <class Names>
+  std::string generate_random_feature_name(int len, const Names& illegal_words, Random& rng) const;
+  template <class Names>
+  std::string extract_class_name(const Names& illegal_words, Random& rng) const;
+  template <class Names>
+  std::string extract_feature_name(const Names& illegal_words, Random& rng) const;
 
   // Corpus handling.
+  // NOTE: The corpus is read through a memory mapping and every word
+  //       is stored once in corpus_names in both of the forms names
+  //       are drawn in: lowercase (features), then capitalized (classes).
+  //       Drawing a name then only copies out the result.
+  struct CorpusWord {
+    size_t offset;        // Of the lowercase form; the capitalized one follows.
+    int length;
+    int keywords;         // The KeywordSets the word is in.
+  };
   void cache_corpus();
+  void add_corpus_word(const char* word, int length);
   std::string corpus_path;
-  std::vector<std::string> corpus = std::vector<std::string>();
+  std::vector<char> corpus_names;
+  std::vector<CorpusWord> corpus;
+
+  // Retry counter, for statistics.
+  mutable std::atomic<long long> rejected_names;
 
   // Name lengths.
   int class_name_length;
@@ -135,4 +192,47 @@ private:
   int variable_name_length;
 };
 
+// CLASS NameAllocator
+// -------------------
+// Hands out distinct names of one type without rejection
+// sampling. The names a NameGenerator can produce are numbered
+// (corpus words by position, random strings as numbers written
+// in their alphabet) and the allocator walks those numbers in
+// the order of a seeded Permutation, so no name comes up twice
+// and each costs O(1).
+//
+// Usage:
+//    Construct from a generator, then call next for each name.
+//
+// NOTES: - Once every name has been handed out, the walk starts
+//          over with a suffix: name_1, then name_2, and so on.
+//        - Keywords and names already in the registry are skipped
+//          (there are only so many of them), so next never throws.
+class NameAllocator {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //        NameGenerator generator
+  //              The generator whose names to hand out. It must
+  //              outlive this object.
+  //        NameType type
+  //              The type of the names.
+  //        Random rng
+  //              The stream the order is drawn from.
+  NameAllocator(const NameGenerator& generator, NameType type, Random& rng);
+
+  // FUNCTION next.
+  // --------------
+  // Returns the next name not in @reserved_names and adds it.
+  std::string next(NameRegistry& reserved_names);
+
+private:
+  const NameGenerator& generator;
+  NameType type;
+  Permutation order;
+  uint64_t count;         // Names walked past so far.
+};
+
 #endif
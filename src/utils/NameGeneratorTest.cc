@@ -0,0 +1,57 @@
+// File: NameGeneratorTest.cc
+// Description: Basic tests for the NameGenerator class.
+
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "NameGenerator.h"
+#include "NameRegistry.h"
+#include "Random.h"
+
+using namespace std;
+
+// Draws @count names of @type into one registry and checks they are distinct.
+static void check_distinct(const NameGenerator& generator, NameType type, int count) {
+	Random rng(1);
+	NameRegistry reserved = NameRegistry();
+	for (int i = 0; i < count; i++) {
+		string name = generator.generate(type, reserved, rng);
+		assert(name.length() > 0);
+		assert(reserved.size() == i + 1);
+	}
+}
+
+int main() {
+
+	// One-letter random names run out after 26: the rest get suffixes
+	// instead of an error.
+	NameGenerator random_names("", 1, 1, 1, 1, 1);
+	check_distinct(random_names, attribute, 200);
+	check_distinct(random_names, className, 200);
+
+	// The same with a two-word corpus.
+	string corpus_path = "/tmp/namegeneratortest_corpus.txt";
+	ofstream corpus(corpus_path.c_str());
+	corpus << "apple\nbanana\n";
+	corpus.close();
+	NameGenerator corpus_names(corpus_path, 1, 1, 1, 1, 1);
+	check_distinct(corpus_names, method, 50);
+	check_distinct(corpus_names, className, 50);
+
+	// Illegal names given as a list are avoided too.
+	Random rng(2);
+	vector<string> illegal = vector<string>();
+	illegal.push_back("apple");
+	illegal.push_back("banana");
+	illegal.push_back("apple_1");
+	string name = corpus_names.generate(variable, illegal, rng);
+	assert(name == "apple_2" || name == "banana_1");
+	remove(corpus_path.c_str());
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
@@ -0,0 +1,51 @@
+// File         : NameRegistry.cc
+// Description  : Implementation of the NameRegistry class.
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "Keywords.h"
+#include "NameRegistry.h"
+
+using namespace std;
+
+// FUNCTION: Constructor.
+NameRegistry::NameRegistry() {}
+
+// FUNCTION: Constructor.
+NameRegistry::NameRegistry(const vector<string>& names) {
+  this->names.reserve(names.size());
+  for (int i = 0; i < names.size(); i++) {
+    insert(names[i]);
+  }
+}
+
+// FUNCTION: insert
+void NameRegistry::insert(const string& name) {
+  names.insert(fold(name.data(), name.length()));
+}
+
+// FUNCTION: erase
+void NameRegistry::erase(const string& name) {
+  names.erase(fold(name.data(), name.length()));
+}
+
+// FUNCTION: contains
+bool NameRegistry::contains(const string& name) const {
+  return contains(name.data(), name.length());
+}
+
+// FUNCTION: contains
+bool NameRegistry::contains(const char* name, int length) const {
+  if (names.empty()) return false;
+  return names.count(fold(name, length)) > 0;
+}
+
+// FUNCTION: Returns the @length characters at @name in lowercase.
+string NameRegistry::fold(const char* name, int length) {
+  string folded = string(name, length);
+  for (int i = 0; i < length; i++) {
+    folded[i] = fold_case(folded[i]);
+  }
+  return folded;
+}
@@ -0,0 +1,68 @@
+// File         : NameRegistry.h
+// Description  : Header file for the NameRegistry class, a set
+//                of reserved names that ignores case.
+
+#ifndef NAMEREGISTRY_H_
+#define NAMEREGISTRY_H_
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// CLASS NameRegistry
+// ------------------
+// A set of names compared ignoring case, as COOL names are
+// checked against each other. Names are stored case-folded
+// in a hash set, so insert and contains cost O(length)
+// whatever the number of names.
+//
+// Usage:
+//    Insert the names that are taken, then ask whether a
+//    candidate is. Pass a registry to NameGenerator::generate
+//    to have it add every name it hands out.
+class NameRegistry {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Builds an empty registry.
+  NameRegistry();
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    [String] names
+  //            The names to start with.
+  NameRegistry(const std::vector<std::string>& names);
+
+  // FUNCTION: insert
+  // ----------------
+  // Adds @name. Does nothing if it is already there.
+  void insert(const std::string& name);
+
+  // FUNCTION: erase
+  // ---------------
+  // Removes @name, in any case. Does nothing if it is not there.
+  void erase(const std::string& name);
+
+  // FUNCTION: contains
+  // ------------------
+  // Returns true if @name is in the registry, ignoring case.
+  bool contains(const std::string& name) const;
+
+  // FUNCTION: contains
+  // ------------------
+  // Returns true if the @length characters at @name are in
+  // the registry, ignoring case.
+  bool contains(const char* name, int length) const;
+
+  void clear() { names.clear(); }
+  int size() const { return names.size(); }
+
+private:
+  static std::string fold(const char* name, int length);
+
+  std::unordered_set<std::string> names; // Lowercase.
+};
+
+#endif
@@ -0,0 +1,61 @@
+// File: NameRegistryTest.cc
+// Description: Basic tests for the NameRegistry class.
+
+#include <cassert>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "NameRegistry.h"
+
+using namespace std;
+
+int main() {
+
+	// Names are found ignoring case.
+	NameRegistry registry = NameRegistry();
+	assert(!registry.contains("Apple"));
+	registry.insert("Apple");
+	registry.insert("banana_2");
+	assert(registry.contains("Apple"));
+	assert(registry.contains("aPPLE"));
+	assert(registry.contains("BANANA_2"));
+	assert(!registry.contains("Apples"));
+	assert(!registry.contains("banana"));
+	assert(registry.size() == 2);
+
+	// Inserting again in another case changes nothing.
+	registry.insert("APPLE");
+	assert(registry.size() == 2);
+
+	// Erasing ignores case too, and leaves the other names.
+	registry.insert("cherry");
+	registry.erase("CHERRY");
+	assert(!registry.contains("cherry"));
+	assert(registry.contains("apple"));
+	registry.erase("cherry");
+	assert(registry.size() == 2);
+
+	// Lookups of part of a buffer.
+	string text = "pineappleBANANA_2";
+	assert(registry.contains(text.data() + 4, 5));
+	assert(registry.contains(text.data() + 9, 8));
+	assert(!registry.contains(text.data(), 9));
+
+	// Built from a list.
+	vector<string> names = vector<string>();
+	names.push_back("Main");
+	names.push_back("main");
+	names.push_back("Object");
+	NameRegistry from_list = NameRegistry(names);
+	assert(from_list.size() == 2);
+	assert(from_list.contains("MAIN"));
+	assert(from_list.contains("object"));
+
+	from_list.clear();
+	assert(from_list.size() == 0);
+	assert(!from_list.contains("Main"));
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
@@ -0,0 +1,220 @@
+// File         : OutputWriter.cc
+// Description  : Implementation of the OutputBuffer and OutputWriter classes.
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "OutputWriter.h"
+
+using namespace std;
+
+// FUNCTION: Constructor.
+OutputBuffer::OutputBuffer(int capacity) {
+  if (capacity <= 0) {
+    throw string("Output buffer size must be positive");
+  }
+  use_storage(capacity);
+}
+
+// FUNCTION: Streams @value out in decimal.
+OutputBuffer& OutputBuffer::operator<<(long long value) {
+  char digits[24];
+  int length = snprintf(digits, sizeof(digits), "%lld", value);
+  append(digits, length);
+  return *this;
+}
+
+// FUNCTION: Grows the buffer to fit @length more bytes.
+void OutputBuffer::overflow(size_t length) {
+  while (capacity - used < length) capacity *= 2;
+  storage.resize(capacity);
+  start = &storage[0];
+}
+
+// FUNCTION: use_storage
+void OutputBuffer::use_storage(size_t capacity) {
+  this->storage = vector<char>(capacity);
+  this->start = &storage[0];
+  this->capacity = capacity;
+  this->used = 0;
+}
+
+// FUNCTION: Constructor.
+OutputWriter::OutputWriter(const string& path, int buffer_size)
+    : OutputWriter(path, buffer_size, O_WRONLY) {}
+
+// FUNCTION: Constructor.
+OutputWriter::OutputWriter(const string& path, int buffer_size, int flags)
+    : OutputBuffer(buffer_size) {
+  this->path = path;
+  this->total_bytes = 0;
+  if (path == "-") {
+    this->fd = STDOUT_FILENO;
+    this->owns_fd = false;
+  } else {
+    this->fd = open(path.c_str(), flags | O_CREAT | O_TRUNC, 0644);
+    this->owns_fd = true;
+    if (fd == -1) {
+      throw "Could not open " + path + ": " + strerror(errno);
+    }
+  }
+
+  // Match the buffer to the pipe, so each write is one pipeful.
+  struct stat info;
+  if (fstat(fd, &info) == 0 && S_ISFIFO(info.st_mode)) {
+#ifdef F_SETPIPE_SZ
+    fcntl(fd, F_SETPIPE_SZ, 1 << 20); // May fail; keep the current size.
+    int pipe_size = fcntl(fd, F_GETPIPE_SZ);
+    if (pipe_size > 0) use_storage(pipe_size);
+#endif
+  }
+}
+
+// FUNCTION: Destructor.
+OutputWriter::~OutputWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+// FUNCTION: flush
+void OutputWriter::flush() {
+  write_through(start, used);
+  used = 0;
+}
+
+// FUNCTION: close
+void OutputWriter::close() {
+  if (fd == -1) return;
+  flush();
+  int result = owns_fd ? ::close(fd) : 0;
+  fd = -1;
+  if (result == -1) {
+    throw "Could not close " + path + ": " + strerror(errno);
+  }
+}
+
+// FUNCTION: Empties the buffer into the file. Text that still
+// doesn't fit is then written straight through by append.
+void OutputWriter::overflow(size_t length) {
+  flush();
+}
+
+// FUNCTION: Writes @length bytes at @data to the file.
+void OutputWriter::write_through(const char* data, size_t length) {
+  if (length == 0) return;
+  if (fd == -1) {
+    throw "Output written to " + path + " after it was closed";
+  }
+  const char* end = data + length;
+  while (data < end) {
+    ssize_t result = write(fd, data, end - data);
+    if (result == -1) {
+      if (errno == EINTR) continue;
+      throw "Could not write to " + path + ": " + strerror(errno);
+    }
+    data += result;
+    total_bytes += result;
+  }
+}
+
+// FUNCTION: Constructor. The file is opened for reading too, since
+// shared writable mappings need it.
+MappedOutputWriter::MappedOutputWriter(const string& path, size_t window_size)
+    : OutputWriter(path, 1, O_RDWR) {
+  struct stat info;
+  if (fstat(fd, &info) == -1 || !S_ISREG(info.st_mode)) {
+    throw "Could not map " + path + ": not a regular file";
+  }
+  this->page_size = sysconf(_SC_PAGESIZE);
+  this->window_size = (window_size + page_size - 1) / page_size * page_size;
+  this->window = NULL;
+  this->window_length = 0;
+  this->file_size = 0;
+  map_window(0);
+}
+
+// FUNCTION: Destructor.
+MappedOutputWriter::~MappedOutputWriter() {
+  try {
+    close();
+  } catch (...) {
+  }
+}
+
+// FUNCTION: close
+void MappedOutputWriter::close() {
+  if (fd == -1) return;
+  unmap_window();
+  if (ftruncate(fd, total_bytes) == -1) {
+    throw "Could not truncate " + path + ": " + strerror(errno);
+  }
+  OutputWriter::close();
+}
+
+// FUNCTION: Slides the window past what has been written. The new
+// window always has room for @length bytes, so nothing is ever
+// written through.
+void MappedOutputWriter::overflow(size_t length) {
+  unmap_window();
+  map_window(length);
+}
+
+// FUNCTION: Maps the window at the end of the text written so far,
+// with room for at least @length bytes. Mappings start on a page, so
+// the text may start partway into the window.
+void MappedOutputWriter::map_window(size_t length) {
+  if (fd == -1) {
+    throw "Output written to " + path + " after it was closed";
+  }
+  off_t offset = total_bytes / page_size * page_size;
+  size_t skip = total_bytes - offset;
+  size_t needed = (skip + length + page_size - 1) / page_size * page_size;
+  window_length = needed > window_size ? needed : window_size;
+  reserve(offset + window_length);
+  void* mapping = mmap(NULL, window_length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset);
+  if (mapping == MAP_FAILED) {
+    throw "Could not map " + path + ": " + strerror(errno);
+  }
+  window = (char*) mapping;
+  start = window + skip;
+  capacity = window_length - skip;
+  used = 0;
+}
+
+// FUNCTION: Unmaps the window, counting the text in it as written.
+void MappedOutputWriter::unmap_window() {
+  if (window == NULL) return;
+  munmap(window, window_length);
+  total_bytes += used;
+  window = NULL;
+  start = NULL;
+  capacity = 0;
+  used = 0;
+}
+
+// FUNCTION: Grows the file to at least @size bytes, allocating the
+// blocks up front where the file system allows it.
+void MappedOutputWriter::reserve(off_t size) {
+  if (size <= file_size) return;
+#ifdef __linux__
+  if (fallocate(fd, 0, file_size, size - file_size) == 0) {
+    file_size = size;
+    return;
+  }
+  if (errno != EOPNOTSUPP) {
+    throw "Could not allocate " + path + ": " + strerror(errno);
+  }
+#endif
+  if (ftruncate(fd, size) == -1) {
+    throw "Could not extend " + path + ": " + strerror(errno);
+  }
+  file_size = size;
+}
@@ -0,0 +1,222 @@
+// File         : OutputWriter.h
+// Description  : Header file for the OutputBuffer and OutputWriter
+//                classes, buffered sinks for the generated code.
+
+#ifndef OUTPUTWRITER_H_
+#define OUTPUTWRITER_H_
+
+#include <sys/types.h>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// CLASS OutputBuffer
+// ------------------
+// An in-memory sink for generated code. Text is streamed in
+// with << and kept in one buffer that grows as needed and is
+// reused after clear.
+//
+// Usage:
+//    Stream text in, read it back with data and size, then
+//    clear to start over without giving up the memory.
+class OutputBuffer {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    Int capacity
+  //            The initial size of the buffer in bytes.
+  OutputBuffer(int capacity = 1 << 16);
+  virtual ~OutputBuffer() {}
+  OutputBuffer(const OutputBuffer&) = delete;
+  OutputBuffer& operator=(const OutputBuffer&) = delete;
+
+  OutputBuffer& operator<<(const std::string& text) {
+    append(text.data(), text.size());
+    return *this;
+  }
+
+  OutputBuffer& operator<<(const char* text) {
+    append(text, strlen(text));
+    return *this;
+  }
+
+  OutputBuffer& operator<<(char c) {
+    if (used == capacity) overflow(1);
+    start[used++] = c;
+    return *this;
+  }
+
+  OutputBuffer& operator<<(long long value);
+  OutputBuffer& operator<<(int value) { return *this << (long long) value; }
+
+  // FUNCTION: append
+  // ----------------
+  // Appends @length bytes starting at @data.
+  void append(const char* data, size_t length) {
+    if (length > capacity - used) {
+      overflow(length);
+      if (length > capacity - used) {
+        write_through(data, length);
+        return;
+      }
+    }
+    memcpy(start + used, data, length);
+    used += length;
+  }
+
+  const char* data() const { return start; }
+  size_t size() const { return used; }
+  void clear() { used = 0; }
+
+protected:
+
+  // FUNCTION: overflow
+  // ------------------
+  // Called when @length more bytes don't fit. Makes room for them
+  // (here by growing the buffer), or leaves the buffer as is if
+  // they should go to write_through instead.
+  virtual void overflow(size_t length);
+
+  // FUNCTION: write_through
+  // -----------------------
+  // Takes @length bytes that overflow chose not to make room for.
+  virtual void write_through(const char* data, size_t length) {}
+
+  // FUNCTION: use_storage
+  // ---------------------
+  // Replaces the buffer with fresh memory of @capacity bytes,
+  // dropping anything still in it.
+  void use_storage(size_t capacity);
+
+  // The bytes being filled are start[0, capacity), of which the
+  // first used are taken. start normally points into storage,
+  // but subclasses may point it at memory of their own.
+  char* start;
+  size_t capacity;
+  size_t used;
+  std::vector<char> storage;
+};
+
+// CLASS OutputWriter
+// ------------------
+// An OutputBuffer of fixed size that is reused for the whole
+// run and handed to a file in big chunks. Nothing is flushed
+// per line: '\n' is just another character, and data only
+// reaches the file when the buffer fills up, on flush or on
+// close. Text larger than the buffer is written straight through.
+//
+// Usage:
+//    Construct with the output path, stream text in with <<
+//    and call close (or let the destructor do it) at the end.
+//    bytes_written counts everything streamed in so far.
+//
+// NOTES: - Errors opening or writing the file throw a string.
+//        - The path "-" stands for stdout, which is flushed but
+//          left open by close.
+//        - When the output is a pipe, the pipe is enlarged (where
+//          the system allows) and the buffer is sized to match, so
+//          every write fills the pipe in one go and the reader gets
+//          the program a pipeful at a time while it is generated.
+class OutputWriter : public OutputBuffer {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    String path
+  //            The file to (over)write, or "-" for stdout.
+  //    Int buffer_size
+  //            The size of the buffer in bytes.
+  OutputWriter(const std::string& path, int buffer_size = 1 << 22);
+
+  // FUNCTION: Destructor.
+  // ---------------------
+  // Closes the file, dropping any error since destructors can't throw.
+  ~OutputWriter();
+
+  // FUNCTION: flush
+  // ---------------
+  // Writes out everything buffered so far.
+  virtual void flush();
+
+  // FUNCTION: close
+  // ---------------
+  // Flushes and closes the file. Further output is an error.
+  virtual void close();
+
+  // FUNCTION: bytes_written
+  // -----------------------
+  // Returns the number of bytes streamed in since construction.
+  long long bytes_written() const { return total_bytes + used; }
+
+protected:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // As above, opening the file with the open(2) @flags.
+  OutputWriter(const std::string& path, int buffer_size, int flags);
+
+  void overflow(size_t length);
+  void write_through(const char* data, size_t length);
+
+  int fd;
+  bool owns_fd;          // False for stdout.
+  std::string path;
+  long long total_bytes; // Bytes handed to the file.
+};
+
+// CLASS MappedOutputWriter
+// ------------------------
+// An OutputWriter that streams text straight into the file
+// through a window of it mapped into memory, so nothing is
+// copied through a buffer and write(). The file is preallocated
+// with fallocate a window at a time, the window slides along
+// as it fills up, and close truncates the file to the bytes
+// actually written.
+//
+// Usage:
+//    As OutputWriter. The path must name a regular file.
+//
+// NOTES: - Preallocating turns a full disk into an error thrown
+//          here rather than a SIGBUS while writing into the window.
+//          Where fallocate isn't supported the file is extended with
+//          ftruncate instead, which gives no such guarantee.
+//        - flush has nothing to do: the window is the file.
+class MappedOutputWriter : public OutputWriter {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    String path
+  //            The file to (over)write.
+  //    Int window_size
+  //            The size of the mapped window in bytes.
+  MappedOutputWriter(const std::string& path, size_t window_size = 1 << 26);
+
+  // FUNCTION: Destructor.
+  // ---------------------
+  // Closes the file, dropping any error since destructors can't throw.
+  ~MappedOutputWriter();
+
+  void flush() {}
+  void close();
+
+protected:
+  void overflow(size_t length);
+
+private:
+  void map_window(size_t length);
+  void unmap_window();
+  void reserve(off_t size);
+
+  size_t window_size;
+  size_t page_size;
+  char* window;          // Start of the mapping, page aligned.
+  size_t window_length;  // Length of the mapping.
+  off_t file_size;       // Bytes allocated to the file.
+};
+
+#endif
@@ -0,0 +1,67 @@
+// File: OutputWriterTest.cc
+// Description: Basic tests for the OutputWriter classes.
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include "OutputWriter.h"
+
+using namespace std;
+
+// Streams the same text into @writer, with pieces both smaller
+// and larger than its buffer, and returns that text.
+string fill(OutputWriter& writer) {
+	string expected = "";
+	for (int i = 0; i < 2000; i++) {
+		string piece = string(i % 37, 'a' + i % 26);
+		if (i % 500 == 0) piece = string(10000, 'z');
+		writer << piece << i << '\n';
+		expected += piece + to_string(i) + "\n";
+	}
+	assert(writer.bytes_written() == expected.size());
+	return expected;
+}
+
+string read_file(string path) {
+	ifstream file(path.c_str());
+	stringstream contents;
+	contents << file.rdbuf();
+	return contents.str();
+}
+
+int main() {
+	string path = "outputwritertest.tmp";
+
+	// Streamed through a small buffer.
+	{
+		OutputWriter writer(path, 1000);
+		string expected = fill(writer);
+		writer.close();
+		assert(read_file(path) == expected);
+	}
+
+	// Mapped through a window of a single page, which slides many
+	// times and has to grow for the larger pieces. The file ends up
+	// exactly as long as the text.
+	{
+		MappedOutputWriter writer(path, 1);
+		string expected = fill(writer);
+		writer.close();
+		assert(read_file(path) == expected);
+	}
+
+	// The destructor closes too, and nothing written is an empty file.
+	{
+		MappedOutputWriter writer(path);
+	}
+	assert(read_file(path) == "");
+
+	remove(path.c_str());
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
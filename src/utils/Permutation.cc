@@ -0,0 +1,38 @@
+// File         : Permutation.cc
+// Description  : Implementation of the Permutation class.
+
+#include <stdint.h>
+#include "Permutation.h"
+#include "Random.h"
+
+// FUNCTION: Constructor.
+Permutation::Permutation(uint64_t size, Random& rng) {
+  if (size == 0 || size > (1ULL << 62)) {
+    throw "Permutation size out of range";
+  }
+  this->permutation_size = size;
+  this->half_bits = 1;
+  while ((1ULL << (2 * half_bits)) < size) half_bits++;
+  this->half_mask = (1ULL << half_bits) - 1;
+  for (int i = 0; i < NUM_ROUNDS; i++) {
+    keys[i] = rng();
+  }
+}
+
+// FUNCTION: Runs @x through the Feistel network. Each round swaps the
+// halves and mixes a keyed hash of one into the other, which can be
+// undone whatever the hash, so the network is a bijection of its
+// 2 * half_bits bits.
+uint64_t Permutation::encrypt(uint64_t x) const {
+  uint64_t left = x >> half_bits;
+  uint64_t right = x & half_mask;
+  for (int i = 0; i < NUM_ROUNDS; i++) {
+    uint64_t z = (right + keys[i]) * 0x9e3779b97f4a7c15ULL;
+    z = (z ^ (z >> 29)) * 0xbf58476d1ce4e5b9ULL;
+    z ^= z >> 32;
+    uint64_t mixed = left ^ (z & half_mask);
+    left = right;
+    right = mixed;
+  }
+  return (left << half_bits) | right;
+}
@@ -0,0 +1,62 @@
+// File         : Permutation.h
+// Description  : Header file for the Permutation class, a seeded
+//                pseudorandom bijection of [0, n).
+
+#ifndef PERMUTATION_H_
+#define PERMUTATION_H_
+
+#include <stdint.h>
+#include "Random.h"
+
+// CLASS Permutation
+// -----------------
+// A pseudorandom ordering of [0, n) that is computed rather
+// than stored, so n can be huge. A balanced Feistel network
+// shuffles the smallest even number of bits that holds n
+// values, and outputs of n or more are fed back through it
+// ("cycle walking") until they land in range.
+//
+// Usage:
+//    Construct with the size and a random stream, then map
+//    0, 1, 2, ... through operator() to visit every number
+//    in [0, n) exactly once, in a random order.
+//
+// NOTES: - The bit width is at most four times n, so a lookup
+//          takes fewer than four walks through the network on
+//          average.
+//        - Sizes are limited to 2^62.
+class Permutation {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    Unsigned size
+  //            The number of elements, n. Must be in [1, 2^62].
+  //    Random rng
+  //            The stream the round keys are drawn from.
+  Permutation(uint64_t size, Random& rng);
+
+  // FUNCTION: operator()
+  // --------------------
+  // Returns the element at position @index, which must be in [0, n).
+  uint64_t operator()(uint64_t index) const {
+    do {
+      index = encrypt(index);
+    } while (index >= permutation_size);
+    return index;
+  }
+
+  uint64_t size() const { return permutation_size; }
+
+private:
+  uint64_t encrypt(uint64_t x) const;
+
+  static const int NUM_ROUNDS = 4;
+  uint64_t permutation_size;
+  int half_bits;
+  uint64_t half_mask;
+  uint64_t keys[NUM_ROUNDS];
+};
+
+#endif
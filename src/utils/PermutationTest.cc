@@ -0,0 +1,58 @@
+// File: PermutationTest.cc
+// Description: Basic tests for the Permutation class.
+
+#include <cassert>
+#include <iostream>
+#include <vector>
+#include "Permutation.h"
+#include "Random.h"
+
+using namespace std;
+
+int main() {
+
+	// Every size gives a bijection of [0, n).
+	uint64_t sizes[] = {1, 2, 3, 4, 5, 10, 1000, 4096, 4097, 10000};
+	for (int i = 0; i < 10; i++) {
+		Random rng(i);
+		Permutation permutation(sizes[i], rng);
+		assert(permutation.size() == sizes[i]);
+		vector<bool> seen = vector<bool>(sizes[i], false);
+		for (uint64_t j = 0; j < sizes[i]; j++) {
+			uint64_t x = permutation(j);
+			assert(x < sizes[i]);
+			assert(!seen[x]);
+			seen[x] = true;
+		}
+	}
+
+	// Equal streams give equal orders, different ones don't.
+	Random a(42);
+	Random b(42);
+	Random c(43);
+	Permutation first(10000, a);
+	Permutation second(10000, b);
+	Permutation other(10000, c);
+	int same_as_other = 0;
+	int fixed_points = 0;
+	for (uint64_t j = 0; j < 10000; j++) {
+		assert(first(j) == second(j));
+		if (first(j) == other(j)) same_as_other++;
+		if (first(j) == j) fixed_points++;
+	}
+	assert(same_as_other < 20);
+	assert(fixed_points < 20);
+
+	// Huge sizes work without storing anything.
+	Random d(7);
+	uint64_t huge = 410000000000000000ULL;
+	Permutation large(huge, d);
+	for (uint64_t j = 0; j < 1000; j++) {
+		assert(large(j) < huge);
+	}
+	assert(large(0) != large(1));
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
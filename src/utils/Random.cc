@@ -0,0 +1,32 @@
+// File         : Random.cc
+// Description  : Implementation of the Random class.
+
+#include <stdint.h>
+#include "Random.h"
+
+// FUNCTION: Advances a splitmix64 state and returns its next output.
+static uint64_t splitmix64(uint64_t& x) {
+  uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+// FUNCTION: Constructor. The state is filled from splitmix64, which
+// never leaves it all zero.
+Random::Random(uint64_t seed) {
+  this->seed = seed;
+  uint64_t x = seed;
+  for (int i = 0; i < 4; i++) {
+    state[i] = splitmix64(x);
+  }
+}
+
+// FUNCTION: Derives the generator for @stream by hashing it together
+// with the seed, so streams don't overlap in any way that matters.
+Random Random::derive(uint64_t stream) const {
+  uint64_t x = seed ^ 0x6a09e667f3bcc909ULL;
+  uint64_t mixed = splitmix64(x);
+  x = mixed ^ stream;
+  return Random(splitmix64(x));
+}
@@ -0,0 +1,85 @@
+// File         : Random.h
+// Description  : Header file for the Random class, a small, fast,
+//                seedable and splittable random number generator.
+
+#ifndef RANDOM_H_
+#define RANDOM_H_
+
+#include <stdint.h>
+
+// CLASS Random
+// ------------
+// xoshiro256** seeded through splitmix64. Every random decision in
+// the generator is drawn from one of these, so a run is fully
+// determined by its seed.
+//
+// Usage:
+//    Construct with a seed, then draw with below (integers) or
+//    uniform (doubles). derive gives an independent generator for
+//    a numbered stream (e.g., one per class), which only depends on
+//    the seed and the stream number, not on draws made so far.
+//
+// NOTES: - This also meets the requirements of a standard uniform
+//          random bit generator, so it can be passed to std::shuffle.
+class Random {
+public:
+  typedef uint64_t result_type;
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    Unsigned seed
+  //            Any 64-bit value; equal seeds give equal sequences.
+  explicit Random(uint64_t seed = 0);
+
+  // FUNCTION: derive
+  // ----------------
+  // Parameters:
+  //    Unsigned stream
+  //            The number of the stream.
+  // Returns:
+  //    A generator for @stream of this generator's seed.
+  Random derive(uint64_t stream) const;
+
+  // FUNCTION: operator()
+  // --------------------
+  // Returns 64 uniformly random bits.
+  uint64_t operator()() {
+    uint64_t result = rotate(state[1] * 5, 7) * 9;
+    uint64_t t = state[1] << 17;
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotate(state[3], 45);
+    return result;
+  }
+
+  // FUNCTION: below
+  // ---------------
+  // Returns a uniformly random number in [0, n). @n must be positive.
+  uint64_t below(uint64_t n) {
+    return (uint64_t) (((unsigned __int128) (*this)() * n) >> 64);
+  }
+
+  // FUNCTION: uniform
+  // -----------------
+  // Returns a uniformly random double in [0, 1).
+  double uniform() {
+    return ((*this)() >> 11) * (1.0 / 9007199254740992.0);
+  }
+
+  static constexpr uint64_t min() { return 0; }
+  static constexpr uint64_t max() { return UINT64_MAX; }
+
+private:
+  static uint64_t rotate(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+  }
+
+  uint64_t seed;
+  uint64_t state[4];
+};
+
+#endif
@@ -0,0 +1,83 @@
+// File: RandomTest.cc
+// Description: Basic tests for the Random class.
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include "Random.h"
+
+using namespace std;
+
+int main() {
+
+	// Equal seeds give equal sequences, different seeds don't.
+	Random a(42);
+	Random b(42);
+	Random c(43);
+	int same_as_c = 0;
+	for (int i = 0; i < 1000; i++) {
+		uint64_t x = a();
+		assert(x == b());
+		if (x == c()) same_as_c++;
+	}
+	assert(same_as_c == 0);
+
+	// A stream only depends on the seed and its number, not on draws made so far.
+	Random root(7);
+	Random first = root.derive(3);
+	for (int i = 0; i < 100; i++) root();
+	Random second = root.derive(3);
+	Random other = root.derive(4);
+	int same_as_other = 0;
+	for (int i = 0; i < 1000; i++) {
+		uint64_t x = first();
+		assert(x == second());
+		if (x == other()) same_as_other++;
+	}
+	assert(same_as_other == 0);
+
+	// Streams of streams are streams too.
+	assert(Random(7).derive(1).derive(2)() == Random(7).derive(1).derive(2)());
+	assert(Random(7).derive(1).derive(2)() != Random(7).derive(2).derive(1)());
+
+	// below stays in range and is close to uniform.
+	Random draws(1);
+	int num_buckets = 10;
+	int num_draws = 100000;
+	vector<int> counts = vector<int>(num_buckets, 0);
+	for (int i = 0; i < num_draws; i++) {
+		uint64_t x = draws.below(num_buckets);
+		assert(x < num_buckets);
+		counts[x]++;
+	}
+	for (int i = 0; i < num_buckets; i++) {
+		assert(fabs(counts[i] - num_draws / num_buckets) < 500);
+	}
+	for (int i = 0; i < 1000; i++) {
+		assert(draws.below(1) == 0);
+	}
+
+	// uniform is in [0, 1) and averages to a half.
+	double total = 0;
+	for (int i = 0; i < num_draws; i++) {
+		double x = draws.uniform();
+		assert(x >= 0 && x < 1);
+		total += x;
+	}
+	assert(fabs(total / num_draws - 0.5) < 0.01);
+
+	// Works as a standard random bit generator.
+	vector<int> permutation = vector<int>();
+	for (int i = 0; i < 20; i++) permutation.push_back(i);
+	vector<int> shuffled = permutation;
+	Random shuffler(5);
+	shuffle(shuffled.begin(), shuffled.end(), shuffler);
+	assert(is_permutation(shuffled.begin(), shuffled.end(), permutation.begin()));
+	assert(shuffled != permutation);
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
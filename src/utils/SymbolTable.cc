@@ -2,43 +2,69 @@
 // Description: Implementation of the symbol table. 
 
 #include "SymbolTable.h"
-#include <map>
+#include <unordered_map>
 #include <string>
 #include <vector>
 #include <utility>
+#include <algorithm>
 #include <iostream>
 
 using namespace std;
 
 SymbolTable::SymbolTable() {
 	this->current_scope = 0;
-	this->table = map<string, vector<pair<string, int> > >();
+	this->entries = vector<Entry>();
+	this->scope_starts = vector<int>(1, 0);
+	this->visible = unordered_map<string, int>();
+	this->bucket_ids = unordered_map<string, int>();
+	this->bucket_ends = vector<int>();
+	this->bucket_members = vector<vector<int> >();
+	this->count_tree = vector<int>(1, 0);
+	this->cover_tree = vector<int>(1, 0);
+}
+
+SymbolTable::SymbolTable(const vector<string>& bucket_types, const vector<int>& bucket_ends) {
+	if (bucket_types.size() != bucket_ends.size()) {
+		throw "Every bucket type needs a bucket end";
+	}
+	this->current_scope = 0;
+	this->entries = vector<Entry>();
+	this->scope_starts = vector<int>(1, 0);
+	this->visible = unordered_map<string, int>();
+	this->bucket_ids = unordered_map<string, int>();
+	for (int i = 0; i < bucket_types.size(); i++) {
+		bucket_ids[bucket_types[i]] = i;
+	}
+	this->bucket_ends = bucket_ends;
+	this->bucket_members = vector<vector<int> >(bucket_types.size());
+	this->count_tree = vector<int>(bucket_types.size() + 1, 0);
+	this->cover_tree = vector<int>(bucket_types.size() + 1, 0);
 }
 
 void SymbolTable::enter_scope() {
 	current_scope++;
+	scope_starts.push_back(entries.size());
 }
 
 void SymbolTable::exit_scope() {
-	map<string, vector<pair<string, int> > >::iterator it = table.begin();
-	while (it != table.end()) {
-		vector<pair<string, int> >& entry = it->second;
 
-		// Remove back if it is in this scope.
-		if (entry.size() != 0 && entry.back().second == current_scope) {
-			entry.pop_back();
-		}
-
-		// Remove the table entry if it's empty.
-		if (entry.size() == 0) {
-			it = table.erase(it);
+	// Undo the current scope's definitions, newest first.
+	int scope_start = scope_starts.back();
+	for (int i = entries.size() - 1; i >= scope_start; i--) {
+		Entry& entry = entries[i];
+		hide(i);
+		if (entry.shadowed == -1) {
+			visible.erase(entry.id);
 		} else {
-			++it;
+			visible[entry.id] = entry.shadowed;
+			show(entry.shadowed);
 		}
 	}
+	entries.erase(entries.begin() + scope_start, entries.end());
 
 	if (current_scope != 0) {
 		current_scope--;
+		scope_starts.pop_back();
 	}
 }
 
@@ -48,51 +74,159 @@ void SymbolTable::add_id(string id, string type) {
 		throw "Type cannot be the empty string";
 	}
 
-	if (table.find(id) == table.end()) {
-		table[id] = vector<pair<string, int> >();
-	} else {
-		vector<pair<string, int> >& entry = table[id];
-		
-		// Remove existing scope definition.
-		if (entry.size() != 0 && entry.back().second == current_scope) {
-			entry.pop_back();
+	unordered_map<string, int>::iterator it = visible.find(id);
+	int shadowed = -1;
+	if (it != visible.end()) {
+
+		// Overwrite existing scope definition.
+		if (entries[it->second].scope == current_scope) {
+			hide(it->second);
+			entries[it->second].type = type;
+			entries[it->second].bucket = bucket_of(type);
+			show(it->second);
+			return;
 		}
+		shadowed = it->second;
+		hide(shadowed);
 	}
-	table[id].push_back(pair<string, int>(type, current_scope));
+
+	Entry entry;
+	entry.id = id;
+	entry.type = type;
+	entry.scope = current_scope;
+	entry.shadowed = shadowed;
+	entry.bucket = bucket_of(type);
+	entry.position = -1;
+	visible[id] = entries.size();
+	entries.push_back(entry);
+	show(entries.size() - 1);
 }
 
 string SymbolTable::lookup(string id) {
-	if (table.find(id) == table.end()) {
+	unordered_map<string, int>::iterator it = visible.find(id);
+	if (it == visible.end()) {
 		return "";
 	} else {
-		return table[id].back().first;
+		return entries[it->second].type;
 	}
 }
 
 vector<pair<string, string> > SymbolTable::current_ids() {
 	vector<pair<string, string> > ids = vector<pair<string, string> >();
-	for (map<string, vector<pair<string, int> > >::iterator it = table.begin(); it != table.end(); ++it) {
-		vector<pair<string, int> > entry = it->second;
-		ids.push_back(pair<string, string>(it->first, entry.back().first));
+	ids.reserve(visible.size());
+	for (unordered_map<string, int>::iterator it = visible.begin(); it != visible.end(); ++it) {
+		ids.push_back(pair<string, string>(it->first, entries[it->second].type));
 	}
+	sort(ids.begin(), ids.end());
 	return ids;
 }
 
-void SymbolTable::print_debug() {
-	cout << "PRINT ------" << endl;
-	for (map<string, vector<pair<string, int> > >::iterator it = table.begin(); it != table.end(); ++it) {
-		vector<pair<string, int> >entry = it->second;
-		cout << it->first << " -> [ ";
-		for (int i = 0; i < entry.size(); i++) {
-			cout << '(' << entry[i].first << ',' << entry[i].second << ") ";
+int SymbolTable::bucket_of(string type) {
+	unordered_map<string, int>::iterator it = bucket_ids.find(type);
+	if (it == bucket_ids.end()) return -1;
+	return it->second;
+}
+
+int SymbolTable::count_in_buckets(int first, int last) {
+	return prefix_count(last) - prefix_count(first);
+}
+
+int SymbolTable::count_covering(int bucket) {
+	int count = 0;
+	for (int i = bucket + 1; i > 0; i -= i & -i) {
+		count += cover_tree[i];
+	}
+	return count;
+}
+
+string SymbolTable::id_in_bucket(int bucket, int n) {
+	return entries[bucket_members[bucket][n]].id;
+}
+
+pair<string, int> SymbolTable::id_in_buckets(int first, int last, int n) {
+	if (n < 0 || n >= count_in_buckets(first, last)) {
+		throw "Index out of range in id_in_buckets";
+	}
+
+	// Descend the Fenwick tree to the bucket holding the
+	// (ids before @first + @n)-th visible id.
+	int remaining = prefix_count(first) + n;
+	int bucket = 0;
+	int step = 1;
+	while (step * 2 < count_tree.size()) step *= 2;
+	for (; step > 0; step /= 2) {
+		if (bucket + step < count_tree.size() && count_tree[bucket + step] <= remaining) {
+			bucket += step;
+			remaining -= count_tree[bucket];
 		}
-		cout << "]" << endl;
 	}
-	cout << "------------" << endl;
+	return pair<string, int>(entries[bucket_members[bucket][remaining]].id, bucket);
 }
 
+// Adds @entry to its bucket. It must not be in it already.
+void SymbolTable::show(int entry) {
+	int bucket = entries[entry].bucket;
+	if (bucket == -1) return;
+	entries[entry].position = bucket_members[bucket].size();
+	bucket_members[bucket].push_back(entry);
+	add_count(bucket, 1);
+	add_cover(bucket, 1);
+}
 
+// Removes @entry from its bucket, moving the bucket's last entry into its place.
+void SymbolTable::hide(int entry) {
+	int bucket = entries[entry].bucket;
+	if (bucket == -1) return;
+	vector<int>& members = bucket_members[bucket];
+	int position = entries[entry].position;
+	members[position] = members.back();
+	entries[members[position]].position = position;
+	members.pop_back();
+	entries[entry].position = -1;
+	add_count(bucket, -1);
+	add_cover(bucket, -1);
+}
 
+void SymbolTable::add_count(int bucket, int delta) {
+	for (int i = bucket + 1; i < count_tree.size(); i += i & -i) {
+		count_tree[i] += delta;
+	}
+}
 
+// Adds @delta to every bucket in the span of @bucket.
+void SymbolTable::add_cover(int bucket, int delta) {
+	for (int i = bucket + 1; i < cover_tree.size(); i += i & -i) {
+		cover_tree[i] += delta;
+	}
+	for (int i = bucket_ends[bucket] + 1; i < cover_tree.size(); i += i & -i) {
+		cover_tree[i] -= delta;
+	}
+}
 
+// Returns the number of visible ids in buckets [0, end).
+int SymbolTable::prefix_count(int end) {
+	int count = 0;
+	for (int i = end; i > 0; i -= i & -i) {
+		count += count_tree[i];
+	}
+	return count;
+}
 
+void SymbolTable::print_debug() {
+	cout << "PRINT ------" << endl;
+	vector<pair<string, string> > ids = current_ids();
+	for (int i = 0; i < ids.size(); i++) {
+
+		// Collect the definitions of this id, outermost first.
+		vector<int> chain = vector<int>();
+		for (int index = visible[ids[i].first]; index != -1; index = entries[index].shadowed) {
+			chain.push_back(index);
+		}
+		cout << ids[i].first << " -> [ ";
+		for (int j = chain.size() - 1; j >= 0; j--) {
+			cout << '(' << entries[chain[j]].type << ',' << entries[chain[j]].scope << ") ";
+		}
+		cout << "]" << endl;
+	}
+	cout << "------------" << endl;
+}
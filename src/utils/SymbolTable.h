@@ -7,7 +7,7 @@
 
 #include <utility>
 #include <string>
-#include <map>
+#include <unordered_map>
 #include <vector>
 
 class SymbolTable {
@@ -17,11 +17,21 @@ public:
 	// base scope to which you can add IDs.
 	SymbolTable();
 
+	// Constructor that also buckets visible ids by type. Bucket b
+	// holds the type @bucket_types[b] and spans the buckets
+	// [b, @bucket_ends[b]). Spans must nest, as they do when the
+	// types are listed in preorder of a class tree and each span
+	// covers a class's subtree. Ids of other types are kept but
+	// are not in any bucket.
+	SymbolTable(const std::vector<std::string>& bucket_types,
+	            const std::vector<int>& bucket_ends);
+
 	// Enters a new scope.
 	void enter_scope();
 
 	// Exits the most recent scope. If we are in the ground scope,
-	// then this just deletes all the entries.
+	// then this just deletes all the entries. Only the entries added
+	// in the scope being exited are touched.
 	void exit_scope();
 
 	// Adds @id of type @type to the table. If an identifier
@@ -36,17 +46,86 @@ public:
 	std::string lookup(std::string id);
 
 	// Returns a vector that contains entries (id, type) with the
-	// closest scoped definitions of all keys in the symbol table.
+	// closest scoped definitions of all keys in the symbol table,
+	// sorted by id.
 	std::vector<std::pair<std::string, std::string> > current_ids();
 
+	// Returns the number of live definitions, shadowed ones included.
+	int size() const { return entries.size(); }
+
+	// Returns the number of scopes entered on top of the base scope
+	// and not yet exited.
+	int num_scopes() const { return current_scope; }
+
+	// Returns the bucket holding @type, or -1 if there is none.
+	int bucket_of(std::string type);
+
+	// Returns the number of visible ids whose type is in @bucket.
+	int bucket_size(int bucket) { return bucket_members[bucket].size(); }
+
+	// Returns the number of visible ids whose type is in one
+	// of the buckets [first, last).
+	int count_in_buckets(int first, int last);
+
+	// Returns the number of visible ids whose type's bucket spans
+	// @bucket (in a class tree: ids declared as an ancestor of, or
+	// the same class as, the class in @bucket).
+	int count_covering(int bucket);
+
+	// Returns the @n-th visible id in @bucket. Ids within a bucket
+	// are in no particular (but deterministic) order.
+	std::string id_in_bucket(int bucket, int n);
+
+	// Returns the @n-th visible id whose type is in one of the
+	// buckets [first, last), along with its bucket.
+	std::pair<std::string, int> id_in_buckets(int first, int last, int n);
+
 	// Prints out the contents of the table. Used for debugging.
 	void print_debug();
 
 private:
+	// One definition of an identifier, along with the index of the
+	// definition of the same id that it shadows (-1 if none), its
+	// bucket (-1 if none) and its position in that bucket while visible.
+	struct Entry {
+		std::string id;
+		std::string type;
+		int scope;
+		int shadowed;
+		int bucket;
+		int position;
+	};
+
+	// Bucket maintenance as definitions become visible or hidden.
+	void show(int entry);
+	void hide(int entry);
+	void add_count(int bucket, int delta);
+	void add_cover(int bucket, int delta);
+	int prefix_count(int end);
+
 	int current_scope;
 
-	// Internal data structure: id -> [(type, scope)]
-	std::map<std::string, std::vector<std::pair<std::string, int> > > table;
+	// Internal data structures:
+	//	entries      : every live definition, in the order they were added. Since
+	//	               ids are only added to the current scope, this is an undo
+	//	               log whose tail holds exactly the current scope's entries.
+	//	scope_starts : scope -> index in entries where that scope begins
+	//	visible      : id -> index of its most closely nested definition
+	std::vector<Entry> entries;
+	std::vector<int> scope_starts;
+	std::unordered_map<std::string, int> visible;
+
+	// Bucket data structures:
+	//	bucket_ids     : type -> bucket
+	//	bucket_ends    : bucket -> end of the span of buckets it covers
+	//	bucket_members : bucket -> indices of visible entries of that type
+	//	count_tree     : Fenwick tree of bucket sizes (range counts, n-th id)
+	//	cover_tree     : Fenwick tree of span starts/ends (covering counts)
+	std::unordered_map<std::string, int> bucket_ids;
+	std::vector<int> bucket_ends;
+	std::vector<std::vector<int> > bucket_members;
+	std::vector<int> count_tree;
+	std::vector<int> cover_tree;
 };
 
 
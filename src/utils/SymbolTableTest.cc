@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <iostream>
+#include <string>
 #include "SymbolTable.h"
 
 using namespace std;
@@ -127,6 +128,166 @@ int main() {
 	table.exit_scope();
 	assert(state == table.current_ids());
 
+	// Test overwriting a shadowing definition in the same scope.
+	table.add_id("x", "X");
+	table.enter_scope();
+	table.add_id("x", "X1");
+	table.add_id("x", "X2");
+	assert(table.lookup("x") == "X2");
+	table.exit_scope();
+	assert(table.lookup("x") == "X");
+
+	// Test reentering a scope after exiting it.
+	table.enter_scope();
+	assert(table.lookup("x") == "X");
+	table.add_id("y", "Y");
+	table.exit_scope();
+	table.enter_scope();
+	assert(table.lookup("y") == "");
+	table.exit_scope();
+
+	// Test current_ids ordering with ids added out of order across scopes.
+	table.add_id("m", "M");
+	table.enter_scope();
+	table.add_id("b", "B");
+	table.add_id("zz", "Z");
+	table.enter_scope();
+	table.add_id("a", "A");
+	table.add_id("m", "M1");
+
+	// Current state:
+	//	a -> [(A, 2)]
+	//	b -> [(B, 1)]
+	//	m -> [(M, 0), (M1, 2)]
+	//	x -> [(X, 0)]
+	//	zz -> [(Z, 1)]
+
+	state = vector<pair<string, string> >();
+	state.push_back(pair<string, string>("a", "A"));
+	state.push_back(pair<string, string>("b", "B"));
+	state.push_back(pair<string, string>("m", "M1"));
+	state.push_back(pair<string, string>("x", "X"));
+	state.push_back(pair<string, string>("zz", "Z"));
+	assert(state == table.current_ids());
+	table.exit_scope();
+	table.exit_scope();
+
+	state = vector<pair<string, string> >();
+	state.push_back(pair<string, string>("m", "M"));
+	state.push_back(pair<string, string>("x", "X"));
+	assert(state == table.current_ids());
+
+	// Test deep nesting of the same id: each exit restores the previous type.
+	int depth = 1000;
+	for (int i = 0; i < depth; i++) {
+		table.enter_scope();
+		table.add_id("x", to_string(i));
+		if (i % 2 == 0) table.add_id(to_string(i), "T");
+	}
+	assert(table.lookup("x") == to_string(depth - 1));
+	assert(table.current_ids().size() == 2 + depth / 2);
+	for (int i = depth - 1; i >= 0; i--) {
+		assert(table.lookup("x") == to_string(i));
+		assert(table.lookup(to_string(i)) == (i % 2 == 0 ? "T" : ""));
+		table.exit_scope();
+		assert(table.lookup(to_string(i)) == "");
+	}
+	assert(table.lookup("x") == "X");
+	assert(state == table.current_ids());
+
+	// Test empty type.
+	bool threw = false;
+	try {
+		table.add_id("e", "");
+	} catch (const char* e) {
+		threw = true;
+	}
+	assert(threw);
+	assert(table.lookup("e") == "");
+
+	// Remove ground scope again.
+	table.exit_scope();
+	state = vector<pair<string, string> >();
+	assert(state == table.current_ids());
+
+	// Test type buckets over the class tree (in preorder, with spans):
+	//	Object [0, 4)
+	//	  A    [1, 3)
+	//	    B  [2, 3)
+	//	  C    [3, 4)
+	//	SELF_TYPE [4, 5)
+	vector<string> types;
+	types.push_back("Object");
+	types.push_back("A");
+	types.push_back("B");
+	types.push_back("C");
+	types.push_back("SELF_TYPE");
+	vector<int> ends;
+	ends.push_back(4);
+	ends.push_back(3);
+	ends.push_back(3);
+	ends.push_back(4);
+	ends.push_back(5);
+	SymbolTable buckets(types, ends);
+	assert(buckets.bucket_of("B") == 2);
+	assert(buckets.bucket_of("Unknown") == -1);
+
+	buckets.add_id("o", "Object");
+	buckets.add_id("a", "A");
+	buckets.add_id("u", "Unknown");
+	buckets.enter_scope();
+	buckets.add_id("b1", "B");
+	buckets.add_id("b2", "B");
+	buckets.add_id("c", "C");
+	buckets.add_id("s", "SELF_TYPE");
+
+	// Range counts: everything below A, and below Object.
+	assert(buckets.count_in_buckets(1, 3) == 3);
+	assert(buckets.count_in_buckets(0, 4) == 5);
+	assert(buckets.bucket_size(2) == 2);
+	assert(buckets.bucket_size(4) == 1);
+
+	// Covering counts: ids declared as B or one of its ancestors.
+	assert(buckets.count_covering(2) == 4);
+	assert(buckets.count_covering(3) == 2);
+	assert(buckets.count_covering(4) == 1);
+
+	// The n-th id in a range walks the buckets in order.
+	assert((buckets.id_in_buckets(1, 3, 0) == pair<string, int>("a", 1)));
+	assert(buckets.id_in_buckets(1, 3, 1).second == 2);
+	assert(buckets.id_in_buckets(1, 3, 2).second == 2);
+	assert((buckets.id_in_buckets(0, 5, 4) == pair<string, int>("c", 3)));
+	assert(buckets.id_in_bucket(4, 0) == "s");
+	threw = false;
+	try {
+		buckets.id_in_buckets(1, 3, 3);
+	} catch (const char* e) {
+		threw = true;
+	}
+	assert(threw);
+
+	// Shadowing moves an id between buckets, and exiting moves it back.
+	buckets.add_id("a", "C");
+	assert(buckets.bucket_size(1) == 0);
+	assert(buckets.bucket_size(3) == 2);
+	assert(buckets.count_covering(2) == 3);
+	buckets.add_id("u", "A");
+	assert(buckets.bucket_size(1) == 1);
+	buckets.add_id("b1", "Object");
+	assert(buckets.bucket_size(2) == 1);
+	assert(buckets.id_in_bucket(2, 0) == "b2");
+	buckets.exit_scope();
+	assert(buckets.count_in_buckets(0, 5) == 2);
+	assert(buckets.bucket_size(1) == 1);
+	assert(buckets.bucket_size(3) == 0);
+	assert(buckets.id_in_bucket(1, 0) == "a");
+	assert(buckets.count_covering(2) == 2);
+
+	// Removing the ground scope empties every bucket.
+	buckets.exit_scope();
+	assert(buckets.count_in_buckets(0, 5) == 0);
+	assert(buckets.count_covering(2) == 0);
+
 	cout << "Tests passed!" << endl;
 
 	return 0;
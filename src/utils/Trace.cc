@@ -0,0 +1,100 @@
+// File         : Trace.cc
+// Description  : Implementation of the TraceWriter class.
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdio>
+#include "Trace.h"
+
+using namespace std;
+
+// FUNCTION: Returns @text as a JSON string literal.
+static string quote(const string& text) {
+  string quoted = "\"";
+  for (int i = 0; i < text.length(); i++) {
+    char c = text[i];
+    if (c == '"' || c == '\\') {
+      quoted += '\\';
+      quoted += c;
+    } else if ((unsigned char) c < 0x20) {
+      char escape[8];
+      snprintf(escape, sizeof(escape), "\\u%04x", c);
+      quoted += escape;
+    } else {
+      quoted += c;
+    }
+  }
+  return quoted + '"';
+}
+
+// FUNCTION: Returns @nanoseconds in microseconds, to the nanosecond.
+static string microseconds(long long nanoseconds) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%lld.%03lld", nanoseconds / 1000, nanoseconds % 1000);
+  return buffer;
+}
+
+// FUNCTION: Constructor.
+TraceWriter::TraceWriter(const string& path)
+    : out(path.c_str())
+    , path(path)
+    , epoch(TraceBuffer::now())
+    , first_event(true)
+    , closed(false) {
+  if (!out) throw "Could not open trace file " + path + ".";
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+  check();
+}
+
+// FUNCTION: Destructor.
+TraceWriter::~TraceWriter() {
+  try {
+    close();
+  } catch (...) {}
+}
+
+// FUNCTION: Separates an event from the previous one.
+void TraceWriter::start_event() {
+  out << (first_event ? "\n" : ",\n");
+  first_event = false;
+}
+
+// FUNCTION: Throws if a write failed.
+void TraceWriter::check() {
+  if (!out) throw "Could not write trace file " + path + ".";
+}
+
+// FUNCTION: name_thread
+void TraceWriter::name_thread(int thread, const string& name) {
+  start_event();
+  out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread
+      << ", \"args\": {\"name\": " << quote(name) << "}}";
+  check();
+}
+
+// FUNCTION: write
+void TraceWriter::write(TraceBuffer& buffer) {
+  const vector<TraceEvent>& events = buffer.events();
+  for (int i = 0; i < events.size(); i++) {
+    const TraceEvent& event = events[i];
+    start_event();
+    out << "{\"name\": " << quote(event.name) << ", \"cat\": \"" << event.category
+        << "\", \"ph\": \"X\", \"ts\": " << microseconds(event.start - epoch)
+        << ", \"dur\": " << microseconds(event.duration)
+        << ", \"pid\": 1, \"tid\": " << buffer.thread();
+    if (!event.args.empty()) out << ", \"args\": {" << event.args << "}";
+    out << "}";
+  }
+  buffer.clear();
+  check();
+}
+
+// FUNCTION: close
+void TraceWriter::close() {
+  if (closed) return;
+  closed = true;
+  out << "\n]}\n";
+  out.close();
+  check();
+}
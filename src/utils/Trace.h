@@ -0,0 +1,156 @@
+// File         : Trace.h
+// Description  : Header file for the TraceBuffer and TraceWriter
+//                classes, which record timelines in the Chrome
+//                trace-event format.
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// STRUCT TraceEvent
+// -----------------
+// One span: what ran, when it started and how long it took (in
+// nanoseconds of the steady clock), and optional arguments given
+// as the inside of a JSON object (e.g. "\"depth\": 3").
+struct TraceEvent {
+  const char* category;
+  std::string name;
+  long long start;
+  long long duration;
+  std::string args;
+};
+
+// CLASS TraceBuffer
+// -----------------
+// Records the spans of one thread. Spans nest: begin opens one and
+// end closes the most recent one still open. Nothing is shared, so
+// each thread can record into its own buffer without locking.
+//
+// Usage:
+//    Call begin and end around the work to time, then hand the
+//    buffer to a TraceWriter, which writes and clears it.
+class TraceBuffer {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    Int thread
+  //            The thread id the spans are shown under.
+  TraceBuffer(int thread = 0) : thread_id(thread) {}
+
+  // FUNCTION: begin
+  // ---------------
+  // Opens a span called @name in @category, which must be a
+  // string literal (it is kept as a pointer).
+  void begin(const char* category, const std::string& name) {
+    open_spans.push_back(spans.size());
+    spans.push_back(TraceEvent());
+    TraceEvent& span = spans.back();
+    span.category = category;
+    span.name = name;
+    span.duration = 0;
+    span.start = now();
+  }
+
+  // FUNCTION: end
+  // -------------
+  // Closes the most recent open span, attaching @args to it.
+  void end(const std::string& args = "") {
+    TraceEvent& span = spans[open_spans.back()];
+    span.duration = now() - span.start;
+    span.args = args;
+    open_spans.pop_back();
+  }
+
+  const std::vector<TraceEvent>& events() const { return spans; }
+  bool empty() const { return spans.empty(); }
+  int thread() const { return thread_id; }
+  void set_thread(int thread) { thread_id = thread; }
+
+  // FUNCTION: clear
+  // ---------------
+  // Drops every span. There must be none open.
+  void clear() { spans.clear(); }
+
+  // FUNCTION: swap
+  // --------------
+  // Exchanges the spans (not the thread) with @other.
+  void swap(TraceBuffer& other) {
+    spans.swap(other.spans);
+    open_spans.swap(other.open_spans);
+  }
+
+  // FUNCTION: now
+  // -------------
+  // Returns the steady clock in nanoseconds.
+  static long long now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+private:
+  int thread_id;
+  std::vector<TraceEvent> spans;
+  std::vector<int> open_spans;  // Indices into spans.
+};
+
+// CLASS TraceWriter
+// -----------------
+// Writes spans to a file in the Chrome trace-event JSON format
+// (complete "X" events), which chrome://tracing and Perfetto load.
+// Times are in microseconds since the writer was constructed.
+//
+// Usage:
+//    Construct with the path, name the threads, write buffers as
+//    they fill up and close at the end.
+//
+// NOTES: - Errors opening or writing the file throw a string.
+//        - A trace cut short (no close) is missing its closing
+//          brackets, which Perfetto still accepts.
+class TraceWriter {
+public:
+
+  // FUNCTION: Constructor.
+  // ----------------------
+  // Parameters:
+  //    String path
+  //            The file to (over)write.
+  TraceWriter(const std::string& path);
+
+  // FUNCTION: Destructor.
+  // ---------------------
+  // Closes the file, dropping any error since destructors can't throw.
+  ~TraceWriter();
+
+  // FUNCTION: name_thread
+  // ---------------------
+  // Labels @thread with @name in the timeline.
+  void name_thread(int thread, const std::string& name);
+
+  // FUNCTION: write
+  // ---------------
+  // Writes the spans of @buffer and clears it.
+  void write(TraceBuffer& buffer);
+
+  // FUNCTION: close
+  // ---------------
+  // Finishes the JSON and closes the file.
+  void close();
+
+private:
+  void start_event();
+  void check();
+
+  std::ofstream out;
+  std::string path;
+  long long epoch;   // Steady clock at construction, in nanoseconds.
+  bool first_event;
+  bool closed;
+};
+
+#endif
@@ -0,0 +1,71 @@
+// File: TraceTest.cc
+// Description: Basic tests for the TraceBuffer and TraceWriter classes.
+
+#include <cassert>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdio>
+#include "Trace.h"
+
+using namespace std;
+
+int main() {
+
+	// Spans nest and keep the order they were opened in.
+	TraceBuffer buffer(3);
+	buffer.begin("class", "Main");
+	buffer.begin("method", "Main.main");
+	buffer.end();
+	buffer.end("\"depth\": 1");
+	assert(buffer.events().size() == 2);
+	assert(buffer.events()[0].name == "Main");
+	assert(buffer.events()[1].name == "Main.main");
+	assert(buffer.events()[0].args == "\"depth\": 1");
+	assert(buffer.events()[1].args.empty());
+	assert(buffer.events()[0].start <= buffer.events()[1].start);
+	assert(buffer.events()[0].duration >= buffer.events()[1].duration);
+	assert(buffer.events()[1].duration >= 0);
+
+	// Swapping moves the spans but not the thread.
+	TraceBuffer other(4);
+	other.swap(buffer);
+	assert(buffer.empty());
+	assert(other.events().size() == 2);
+	assert(other.thread() == 4);
+
+	// Written as trace events, clearing the buffer.
+	string path = "tracetest.tmp";
+	{
+		TraceWriter writer(path);
+		writer.name_thread(4, "worker \"4\"");
+		writer.write(other);
+		assert(other.empty());
+		writer.close();
+	}
+	ifstream file(path.c_str());
+	stringstream contents;
+	contents << file.rdbuf();
+	string json = contents.str();
+	assert(json.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": [") == 0);
+	assert(json.find("\"args\": {\"name\": \"worker \\\"4\\\"\"}") != string::npos);
+	assert(json.find("{\"name\": \"Main\", \"cat\": \"class\", \"ph\": \"X\"") != string::npos);
+	assert(json.find("\"tid\": 4, \"args\": {\"depth\": 1}}") != string::npos);
+	assert(json.find("\"name\": \"Main.main\"") < json.size());
+	assert(json.substr(json.size() - 3) == "]}\n");
+	remove(path.c_str());
+
+	// Unwritable paths throw.
+	bool threw = false;
+	try {
+		TraceWriter writer("no_such_directory/trace.json");
+	} catch (string e) {
+		threw = true;
+	}
+	assert(threw);
+
+	cout << "Tests passed!" << endl;
+
+	return 0;
+}
@@ -2,6 +2,8 @@
 // Description  : Variety of useful functions.
 
 #include <string>
+#include <stdexcept>
+#include <stdint.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fstream>
@@ -13,7 +15,7 @@
 using namespace std;
 
 // FUNCTION: Returns true if words are equal ignoring case.
-bool compare_case_insensitive(string a, string b) {
+bool compare_case_insensitive(const string& a, const string& b) {
   if (a.length() != b.length()) return false;
   for (int i = 0; i < a.length(); i++) {
     if (tolower(a[i]) != tolower(b[i])) return false;
@@ -22,7 +24,7 @@ bool compare_case_insensitive(string a, string b) {
 }
 
 // FUNCTION: Returns true if @str is contained in @word_vector ignoring case.
-bool string_vector_contains(string str, vector<string> word_vector) {
+bool string_vector_contains(const string& str, const vector<string>& word_vector) {
   for(int i = 0; i < word_vector.size(); i++) {
     if (compare_case_insensitive(word_vector[i], str)) {
       return true;
@@ -48,3 +50,38 @@ string get_current_working_directory() {
   }
   return string(ptr);
 }
+
+// FUNCTION: Parses all of @text as an int into @value. Otherwise prints
+// why @option can't take it and returns false.
+bool parse_int(const char* option, const string& text, int& value) {
+  try {
+    size_t length = 0;
+    value = stoi(text, &length);
+    if (length == text.length()) return true;
+  }
+  catch (const invalid_argument&) {}
+  catch (const std::out_of_range&) {
+    cerr << "Out of range value for " << option << ": " << text << endl;
+    return false;
+  }
+  cerr << "Invalid value for " << option << ": " << text << endl;
+  return false;
+}
+
+// FUNCTION: Parses all of @text as a nonnegative seed into @value.
+// NOTES: stoull would accept a sign and wrap -1 around to 2^64 - 1,
+//        so only digits are allowed.
+bool parse_seed(const string& text, uint64_t& value) {
+  if (text.empty() || text.find_first_not_of("0123456789") != string::npos) {
+    cerr << "Invalid value for -s: " << text << " (must be a nonnegative number)" << endl;
+    return false;
+  }
+  try {
+    value = stoull(text);
+  }
+  catch (const std::out_of_range&) {
+    cerr << "Out of range value for -s: " << text << endl;
+    return false;
+  }
+  return true;
+}
@@ -4,9 +4,12 @@
 #include <string>
 #include <vector>
 #include <stdlib.h>
+#include <stdint.h>
 
 using namespace std;
 
-bool compare_case_insensitive(string a, string b);
-bool string_vector_contains(string str, vector<string> word_vector);
+bool compare_case_insensitive(const string& a, const string& b);
+bool string_vector_contains(const string& str, const vector<string>& word_vector);
 string get_current_working_directory();
+bool parse_int(const char* option, const string& text, int& value);
+bool parse_seed(const string& text, uint64_t& value);